@@ -1,9 +1,26 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+struct Light {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float falloff;
+};
+
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    Light light;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
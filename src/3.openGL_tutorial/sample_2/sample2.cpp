@@ -5,66 +5,35 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
 
+#include "../../Part02/Maps/gl_state.h"
+#include "../../Part02/Maps/dynamic_buffer.h"
+#include "../../Part02/Maps/uniform_buffer.h"
+#include "../../Part02/Maps/mesh_library.h"
+#include "../../Part02/Maps/scene_graph.h"
+#include "../../Part02/Maps/culling.h"
+#include "../../Part02/Maps/render_queue.h"
+#include "../../Part02/Maps/texture_loader.h"
+#include "../../Part02/Maps/texture_array.h"
+#include "../../Part02/Maps/profiler.h"
+#include "../../Part02/Maps/benchmark.h"
+#include "../../Part02/Maps/fixed_timestep.h"
+#include "../../Part02/Maps/input.h"
+
 #include <iostream>
 #include <string>
+#include <algorithm>
 
 #define PI 3.14159265
 
-// Box coordinate with 36 vertices.
-// Every 3 coordinates will form 1 triangle.
-// The last 2 columns represent texture coordinate for mapping.
-float box[] = {
-	// positions          // normals           // texture coords
-	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-
-	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-
-	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-	-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-	-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-
-	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
-	 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
-};
-
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void process_input(GLFWwindow *window);
-unsigned int loadTexture(char const * path);
+void toggle_button();
+void toggle_coordinates();
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -82,25 +51,39 @@ glm::vec3 light_pos(0.0f, 1.0f, 0.1f);
 float delta_time = 0.0f;	// time between current frame and last frame
 float last_frame = 0.0f;
 
+// simulation runs at a fixed 60 ticks per second, whatever the frame rate
+FixedTimestep simulation_clock(60.0f);
+
+// keyboard events from GLFW's callbacks; each press toggles once, so no repeat delay is needed
+InputSystem input;
+enum input_actions { INPUT_QUIT, INPUT_FORWARD, INPUT_BACKWARD, INPUT_LEFT, INPUT_RIGHT, INPUT_RUN, INPUT_BUTTON, INPUT_PROFILE, INPUT_COORDINATES };
+
 //Toggle (Animation or states)
 bool BUTTON_PRESSED = false;
-int BUTTON_DELAY = 0;
 bool BUTTON_CLOSE_ENOUGH = false;
 
 bool SHOW_COORDINATE = false;
-int SHOW_DELAY = 0;
+
+bool PRINT_PROFILE = false;
 
 
-//Animation Variables
-float curtin_rotate_y = 0.0;
-float curtin_translate_y = 0.0;
+//Animation Variables, in degrees, kept for the last two ticks
+Interpolated<float> curtin_rotate_y(0.0f);
+Interpolated<float> curtin_translate_y(0.0f);
 
-// Countdown until the button trigger can be pressed again.
-// This prevents accidental burst repeat clicking of the key.
-void update_delay()
+// One simulation tick: the curtin turns while the button is pressed.
+void simulate()
 {
-	if(BUTTON_DELAY > 0) BUTTON_DELAY -= 1;
-	if(SHOW_DELAY > 0) SHOW_DELAY -= 1;
+	curtin_translate_y.store();
+	curtin_rotate_y.store();
+
+	if(BUTTON_PRESSED == true)
+	{
+		curtin_translate_y.current += 1.0f;
+		curtin_rotate_y.current += 1.0f;
+		if(curtin_translate_y.current >= 360.0f) curtin_translate_y.shift(-360.0f);
+		if(curtin_rotate_y.current >= 360.0f) curtin_rotate_y.shift(-360.0f);
+	}
 }
 
 // Toggle button pressing only if the camera is close enough.
@@ -112,14 +95,23 @@ void toggle_button_distance(glm::vec3 button_pos)
 		BUTTON_CLOSE_ENOUGH = false;
 }
 
-int main()
+// actions the benchmark script can trigger
+enum benchmark_actions { ACTION_PRESS_BUTTON, ACTION_TOGGLE_COORDINATES };
+
+int main(int argc, char **argv)
 {
+	// "--benchmark" runs a scripted, headless session instead (see benchmark.h)
+	Benchmark benchmark;
+	if (!benchmark.parse(argc, argv))
+		return -1;
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	benchmark.windowHints();
 
 #ifdef __APPLE__
 //	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement for OS X
@@ -137,6 +129,17 @@ int main()
 	glfwMakeContextCurrent(window);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
+	input.bind(GLFW_KEY_ESCAPE, INPUT_QUIT);
+	input.bind(GLFW_KEY_W, INPUT_FORWARD);
+	input.bind(GLFW_KEY_S, INPUT_BACKWARD);
+	input.bind(GLFW_KEY_A, INPUT_LEFT);
+	input.bind(GLFW_KEY_D, INPUT_RIGHT);
+	input.bind(GLFW_KEY_LEFT_SHIFT, INPUT_RUN);
+	input.bind(GLFW_KEY_R, INPUT_BUTTON);
+	input.bind(GLFW_KEY_T, INPUT_PROFILE);
+	input.bind(GLFW_KEY_C, INPUT_COORDINATES);
+	input.attach(window);
+
 	// glad: load all OpenGL function pointers
 	// ---------------------------------------
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -145,96 +148,234 @@ int main()
 		return -1;
 	}
 
+	// the benchmark measures throughput, so it must not wait for vsync
+	if (benchmark.enabled)
+		glfwSwapInterval(0);
+
 	// configure global opengl state
 	// -----------------------------
-	glEnable(GL_DEPTH_TEST);
+	glState().setEnabled(GL_DEPTH_TEST, true);
 
 	// build and compile our shader zprogram
 	// ------------------------------------
 	Shader lighting_shader("./sample2.vs", "./sample2.fs");
 	Shader lamp_shader("./lamp.vs", "./lamp.fs");
 
-	// set up vertex data (and buffer(s)) and configure vertex attributes
-	// ------------------------------------------------------------------
-
-	unsigned int VBO_box, VAO_box;
+	// per-frame camera/light block shared by both programs
+	FrameUniforms frame_uniforms;
+	frame_uniforms.attach(lighting_shader.ID);
+	frame_uniforms.attach(lamp_shader.ID);
 
-	glGenVertexArrays(1, &VAO_box);
-	glGenBuffers(1, &VBO_box);
-
-	glBindVertexArray(VAO_box);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO_box);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(box), box, GL_STATIC_DRAW);
-
-	//vertex coordinates
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//normal vectors
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	//texture coordinates
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
+	// the block is rewritten every frame, so it goes through a ring with a region per frame in flight
+	DynamicBuffer frame_stream(4096);
 
+	// set up vertex data (and buffer(s)) and configure vertex attributes
+	// ------------------------------------------------------------------
 
+	// every object is the same cube, generated at compile time and drawn indexed (see mesh_library.h);
+	// the light uses it too, reading only the position attribute
+	MeshPool mesh_pool;
+	Mesh box_mesh = mesh_pool.add(CUBE_MESH);
+	mesh_pool.build();
 
-	// second, configure the light's VAO (VBO stays the same; the vertices are the same for the light object which is also a 3D cube)
-	unsigned int VAO_light;
-	glGenVertexArrays(1, &VAO_light);
-	glBindVertexArray(VAO_light);
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO_box);
-	// note that we update the lamp's position attribute's stride to reflect the updated buffer data
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
 
+	// load and create a texture 
+	// -------------------------
+	// decoded on worker threads; each texture shows a placeholder until it is uploaded
+	// textures baked with TextureBake --flip upload straight from the pack, without decoding
+	TexturePack texture_pack;
+	TextureLoader texture_loader(true);
+
+	if (texture_pack.open(FileSystem::getPath("resources/textures_flipped.pack")))
+		texture_loader.usePack(&texture_pack);
+
+	// diffuse and specular maps go into two arrays at matching layers, so every
+	// object draws with the same two bindings and only picks its layer
+	const char *material_paths[][2] = {
+		{ "resources/textures/wood2.jpg", "resources/textures/wood2_specular.jpg" },
+		{ "resources/textures/street.png", "resources/textures/street_specular.png" },
+		{ "resources/textures/grass.jpg", "resources/textures/grass_specular.jpg" },
+		{ "resources/textures/marble.jpg", "resources/textures/marble_specular.jpg" },
+		{ "resources/textures/curtin.jpg", "resources/textures/curtin_specular.jpg" },
+
+		{ "resources/textures/red_dark.jpg", "resources/textures/red_dark_specular.jpg" },
+		{ "resources/textures/red_bright.jpg", "resources/textures/red_bright_specular.jpg" },
+		{ "resources/textures/red.jpg", "resources/textures/red_specular.jpg" },
+		{ "resources/textures/green.jpg", "resources/textures/green_specular.jpg" },
+		{ "resources/textures/blue.jpg", "resources/textures/blue_specular.jpg" }
+	};
+	const unsigned int material_count = sizeof(material_paths) / sizeof(material_paths[0]);
+
+	// each array's layers are as large as the largest texture going into it
+	int layer_width[2] = { 1, 1 }, layer_height[2] = { 1, 1 };
+	for(unsigned int m = 0; m < material_count; m++)
+	{
+		for(int map = 0; map < 2; map++)
+		{
+			int width, height;
+			if(texture_loader.imageSize(FileSystem::getPath(material_paths[m][map]), width, height))
+			{
+				layer_width[map] = std::max(layer_width[map], width);
+				layer_height[map] = std::max(layer_height[map], height);
+			}
+		}
+	}
 
+	TextureArray diffuse_array(layer_width[0], layer_height[0], material_count);
+	TextureArray specular_array(layer_width[1], layer_height[1], material_count);
 
+	int material_layers[material_count];
+	for(unsigned int m = 0; m < material_count; m++)
+	{
+		specular_array.load(texture_loader, FileSystem::getPath(material_paths[m][1]));
+		material_layers[m] = diffuse_array.load(texture_loader, FileSystem::getPath(material_paths[m][0]));
+	}
 
+	int layer_wood = material_layers[0];
+	int layer_street = material_layers[1];
+	int layer_grass = material_layers[2];
+	int layer_marble = material_layers[3];
+	int layer_curtin = material_layers[4];
 
-	// load and create a texture 
-	// -------------------------
-	unsigned int tex_wood_diffuse, tex_street_diffuse, tex_grass_diffuse, tex_marble_diffuse, tex_curtin_diffuse;
-	unsigned int tex_wood_specular, tex_street_specular, tex_grass_specular, tex_marble_specular, tex_curtin_specular;
-
-	unsigned int tex_red_dark_diffuse, tex_red_bright_diffuse, tex_red_diffuse, tex_green_diffuse, tex_blue_diffuse;
-	unsigned int tex_red_dark_specular, tex_red_bright_specular, tex_red_specular, tex_green_specular, tex_blue_specular;
-
-	tex_wood_diffuse = loadTexture(FileSystem::getPath("resources/textures/wood2.jpg").c_str());
-	tex_wood_specular = loadTexture(FileSystem::getPath("resources/textures/wood2_specular.jpg").c_str());
-	tex_street_diffuse = loadTexture(FileSystem::getPath("resources/textures/street.png").c_str());
-	tex_street_specular = loadTexture(FileSystem::getPath("resources/textures/street_specular.png").c_str());
-	tex_grass_diffuse = loadTexture(FileSystem::getPath("resources/textures/grass.jpg").c_str());
-	tex_grass_specular = loadTexture(FileSystem::getPath("resources/textures/grass_specular.jpg").c_str());
-	tex_marble_diffuse = loadTexture(FileSystem::getPath("resources/textures/marble.jpg").c_str());
-	tex_marble_specular = loadTexture(FileSystem::getPath("resources/textures/marble_specular.jpg").c_str());
-	tex_curtin_diffuse = loadTexture(FileSystem::getPath("resources/textures/curtin.jpg").c_str());
-	tex_curtin_specular = loadTexture(FileSystem::getPath("resources/textures/curtin_specular.jpg").c_str());
-
-	tex_red_dark_diffuse = loadTexture(FileSystem::getPath("resources/textures/red_dark.jpg").c_str());
-	tex_red_dark_specular = loadTexture(FileSystem::getPath("resources/textures/red_dark_specular.jpg").c_str());
-	tex_red_bright_diffuse = loadTexture(FileSystem::getPath("resources/textures/red_bright.jpg").c_str());
-	tex_red_bright_specular = loadTexture(FileSystem::getPath("resources/textures/red_bright_specular.jpg").c_str());
-	tex_red_diffuse = loadTexture(FileSystem::getPath("resources/textures/red.jpg").c_str());
-	tex_red_specular = loadTexture(FileSystem::getPath("resources/textures/red_specular.jpg").c_str());
-	tex_green_diffuse = loadTexture(FileSystem::getPath("resources/textures/green.jpg").c_str());
-	tex_green_specular = loadTexture(FileSystem::getPath("resources/textures/green_specular.jpg").c_str());
-	tex_blue_diffuse = loadTexture(FileSystem::getPath("resources/textures/blue.jpg").c_str());
-	tex_blue_specular = loadTexture(FileSystem::getPath("resources/textures/blue_specular.jpg").c_str());
+	int layer_red_dark = material_layers[5];
+	int layer_red_bright = material_layers[6];
+	int layer_red = material_layers[7];
+	int layer_green = material_layers[8];
+	int layer_blue = material_layers[9];
 
 
 
 	
 	//shader configuration -------------------------------------------------------------------------------------------
-	lighting_shader.use();
+	glState().useProgram(lighting_shader.ID);
 	lighting_shader.setInt("material.diffuse", 0);
 	lighting_shader.setInt("material.specular", 1);
 
-	// pass projection matrix to shader (as projection matrix rarely changes there's no need to do this per frame)
-	// -----------------------------------------------------------------------------------------------------------
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 300.0f);
-	lighting_shader.setMat4("projection", projection);
+	// shader_m.h looks a location up on every set call, so the ones the draw loop sets are looked up here once
+	const GLint lighting_shininess_location = glGetUniformLocation(lighting_shader.ID, "material.shininess");
+	const GLint lighting_layer_location = glGetUniformLocation(lighting_shader.ID, "material.layer");
+	const GLint lighting_model_location = glGetUniformLocation(lighting_shader.ID, "model");
+	const GLint lighting_normal_matrix_location = glGetUniformLocation(lighting_shader.ID, "normalMatrix");
+	const GLint lamp_intensity_location = glGetUniformLocation(lamp_shader.ID, "intensity");
+	const GLint lamp_model_location = glGetUniformLocation(lamp_shader.ID, "model");
+
+	// projection matrix rarely changes, so it is only computed once
+	// -------------------------------------------------------------
+	const float view_distance = 300.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, view_distance);
+
+	// scene transforms: everything is static except the button and the Curtin logo
+	// -----------------------------------------------------------------------------
+	SceneGraph scene;
+
+	//Coordinate System
+	glm::vec3 coord_scales[] = {
+		glm::vec3( 100.0f,  0.02f,  0.02f),	//X
+		glm::vec3( 0.02f,  100.0f,  0.02f),	//Y
+		glm::vec3( 0.02f,  0.02f,  100.0f),	//Z
+	};
+	int coord_nodes[3];
+	for(int tab = 0; tab < 3; tab++)
+		coord_nodes[tab] = scene.addNode(-1, glm::vec3(0.0f), glm::quat(), coord_scales[tab]);
+
+	//Street & Grass
+	int street_node = scene.addNode(-1, glm::vec3(0.0f), glm::quat(), glm::vec3(3.0f, 0.001f, 7.0f));
+	int grass_node = scene.addNode(-1, glm::vec3(0.0f, -0.01f, 0.0f), glm::quat(), glm::vec3(7.0f, 0.001f, 7.0f));
+
+	//Table (4 tall boxes for legs & 1 thin box as table top)
+	glm::vec3 table_scales[] = {
+		glm::vec3( 1.0f,  0.1f,  1.0f),	//top
+		glm::vec3( 0.1f,  0.5f,  0.1f),//near left
+		glm::vec3( 0.1f,  0.5f,  0.1f),	//near right
+		glm::vec3( 0.1f,  0.5f,  0.1f),//far left
+		glm::vec3( 0.1f,  0.5f,  0.1f),	//far right
+	};
+	glm::vec3 table_positions[] = {
+		glm::vec3( 0.0f,  0.5f,  0.0f),		//top
+		glm::vec3(-0.45f, 0.0f,  0.45f),	//near left
+		glm::vec3( 0.45f, 0.0f,  0.45f),	//near right
+		glm::vec3(-0.45f, 0.0f, -0.45f),	//far left
+		glm::vec3( 0.45f, 0.0f, -0.45f),	//far right
+	};
+	int table_nodes[5];
+	for(int tab = 0; tab < 5; tab++)
+	{
+		// boxes are lifted by half their height so they rest on their position
+		glm::vec3 lift = glm::vec3(0.0f, 0.5f * table_scales[tab].y, 0.0f);
+		table_nodes[tab] = scene.addNode(-1, table_positions[tab] + lift, glm::quat(), table_scales[tab]);
+	}
+
+	//Button on table (1 big box & 1 small box as button)
+	glm::vec3 button_scales[] = {
+		glm::vec3( 0.2f,  0.12f,  0.2f),		//case
+		glm::vec3( 0.12f,  0.12f,  0.12f),		//button
+	};
+	glm::vec3 button_final_location = glm::vec3(0.0f, 0.56f, 0.25f);
+	int button_root = scene.addNode(-1, button_final_location);
+	int button_nodes[2];
+	for(int tab = 0; tab < 2; tab++)
+		button_nodes[tab] = scene.addNode(button_root, glm::vec3(0.0f, 0.5f * button_scales[tab].y, 0.0f), glm::quat(), button_scales[tab]);
+
+	//Curtin Logo
+	int curtin_node = scene.addNode(-1, glm::vec3(0.0f, 0.9f, -0.35f), glm::quat(), glm::vec3(0.2f, 0.2f, 0.001f));
+
+	//Light source (a smaller cube)
+	int light_node = scene.addNode(-1, light_pos, glm::quat(), glm::vec3(0.01f));
+
+	// every box is tested against the view frustum through a BVH of their world bounds
+	SceneCuller culler;
+	AABB box_bounds(box_mesh);
+	for(int tab = 0; tab < 3; tab++) culler.add(coord_nodes[tab], box_bounds);
+	culler.add(street_node, box_bounds);
+	culler.add(grass_node, box_bounds);
+	for(int tab = 0; tab < 5; tab++) culler.add(table_nodes[tab], box_bounds);
+	for(int tab = 0; tab < 2; tab++) culler.add(button_nodes[tab], box_bounds);
+	culler.add(curtin_node, box_bounds);
+
+	// each frame's draws, sorted by program, material layer and distance before they are issued
+	// -------------------------------------------------------------------------------------------
+	const unsigned int LIGHTING_PROGRAM = 0;
+	const unsigned int LAMP_PROGRAM = 1;
+
+	struct SceneDraw
+	{
+		int node;
+		int layer;
+		unsigned int program;
+	};
+
+	std::vector<SceneDraw> scene_draws;
+	RenderQueue render_queue;
+
+	// CPU and GPU timings of building and drawing the queue, reported with "T"
+	// -------------------------------------------------------------------------
+	Profiler profiler(benchmark.enabled ? benchmark.frameCount : 300);
+	int queue_section = profiler.section("queue");
+	int draw_section = profiler.section("draw");
+
+	// benchmark script: every run starts with all textures in place
+	// ---------------------------------------------------------------
+	if (benchmark.enabled)
+	{
+		unsigned int remaining;
+		do
+		{
+			remaining = texture_loader.update(~0u);
+			diffuse_array.refresh(texture_loader.uploaded());
+			specular_array.refresh(texture_loader.uploaded());
+		} while (remaining > 0);
+
+		// walk up to the table, press the button, show the axes, then circle the scene
+		benchmark.addCameraKey(0.0f, glm::vec3(0.0f, 0.9f, 3.0f), -90.0f, 0.0f);
+		benchmark.addCameraKey(3.0f, glm::vec3(0.0f, 0.9f, 1.5f), -90.0f, -15.0f);
+		benchmark.addCameraKey(6.0f, glm::vec3(2.0f, 1.5f, 2.0f), -135.0f, -20.0f);
+		benchmark.addCameraKey(10.0f, glm::vec3(-2.0f, 1.2f, 1.0f), -30.0f, -10.0f);
+
+		benchmark.addAction(3.5f, ACTION_PRESS_BUTTON);
+		benchmark.addAction(4.0f, ACTION_TOGGLE_COORDINATES);
+		benchmark.addAction(9.0f, ACTION_TOGGLE_COORDINATES);
+	}
 
 
 
@@ -242,307 +383,255 @@ int main()
 	// -----------
 	while (!glfwWindowShouldClose(window))
 	{
+		// in benchmark mode the clock advances by a fixed step per frame
+		if (benchmark.enabled && !benchmark.beginFrame())
+			break;
+
 		// per-frame time logic
 		// --------------------
-		float currentFrame = glfwGetTime();
+		// the benchmark's own clock, not glfwGetTime() read a moment after it was
+		// set, so every run splits its frames into the same simulation ticks
+		float currentFrame = benchmark.enabled ? benchmark.time() : (float)glfwGetTime();
 		delta_time = currentFrame - last_frame;
 		last_frame = currentFrame;
 
-		//update delay countdown
-		update_delay();
+		profiler.beginFrame();
+		glState().beginFrame();
 
 		// input
 		// -----
-		process_input(window);
-
-		// render
-		// ------
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
-
-
-		// activate shader
-		lighting_shader.use();
-		lighting_shader.setVec3("light.position", light_pos);
-        	lighting_shader.setVec3("viewPos", camera_pos);
-
-		// light properties
-		lighting_shader.setVec3("light.ambient", 0.1f, 0.1f, 0.1f);
-
-		if(BUTTON_PRESSED == true)
+		if (!benchmark.enabled)
 		{
-			lighting_shader.setVec3("light.diffuse", 0.8f, 0.8f, 0.8f);
-			lighting_shader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
+			process_input(window);
 		}
 		else
 		{
-			lighting_shader.setVec3("light.diffuse", 0.0f, 0.0f, 0.0f);
-			lighting_shader.setVec3("light.specular", 0.0f, 0.0f, 0.0f);
-		}
-
-		// material properties
-        	lighting_shader.setFloat("material.shininess", 65.0f);
-		// for now just set the same for every object. But, you can make it dynamic for various objects.
+			// keys are ignored, but the queue must still be emptied
+			input.dispatch(currentFrame);
 
+			float yaw, pitch;
+			benchmark.camera(camera_pos, yaw, pitch);
+			camera_front = Benchmark::front(yaw, pitch);
 
-		// camera/view transformation
-		glm::mat4 view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
-		lighting_shader.setMat4("view", view);
+			std::vector<int> actions = benchmark.dueActions();
+			for (size_t a = 0; a < actions.size(); a++)
+			{
+				if (actions[a] == ACTION_PRESS_BUTTON && BUTTON_CLOSE_ENOUGH == true)
+					toggle_button();
+				else if (actions[a] == ACTION_TOGGLE_COORDINATES)
+					toggle_coordinates();
+			}
+		}
 
-		//declare transformation matrix
-		glm::mat4 model = glm::mat4();
-		/*
-		//example (remember, it is in column matrix position, so the order is reversed.)
-		model = glm::translate(model, glm::vec3(1.0f, 2.0f, 3.0f)); 			// translate by (1.0, 2.0, 3.0)
-		model = glm::scale(model, glm::vec3(2.0f, 5.0f, 3.0f)); 			// scale by (2.0, 5.0, 3.0) on X, Y, and Z respectively.
-		model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));	// rotate 45 degree about Y-axis (0,1,0)
-		*/
+		// run the simulation ticks this frame owes
+		simulation_clock.advance(delta_time);
+		while(simulation_clock.tick())
+			simulate();
 
+		// how far between the last two ticks this frame is drawn
+		float alpha = simulation_clock.alpha();
 
+		if(PRINT_PROFILE == true)
+		{
+			profiler.report(std::cout);
+			std::cout << "culling: " << culler.stats.visible << " of " << culler.stats.objects << " objects visible, "
+				<< culler.stats.nodeTests << " BVH nodes tested" << std::endl;
+			std::cout << "state: " << glState().lastFrame.calls << " GL state calls made, " << glState().lastFrame.elided
+				<< " redundant ones skipped last frame" << std::endl;
+			PRINT_PROFILE = false;
+		}
 
+		// swap in any textures that finished decoding
+		texture_loader.update();
+		diffuse_array.refresh(texture_loader.uploaded());
+		specular_array.refresh(texture_loader.uploaded());
 
-		//Draw objects
-		//------------------------------------------------------------------------------------------
+		// render
+		// ------
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
 
 
-		//Coordinate System
-		if(SHOW_COORDINATE == true)
-		{
-			
-			glm::vec3 coord_scales[] = {
-				glm::vec3( 100.0f,  0.02f,  0.02f),	//X
-				glm::vec3( 0.02f,  100.0f,  0.02f),	//Y
-				glm::vec3( 0.02f,  0.02f,  100.0f),	//Z
-			};
+		// light properties (falloff is unused by sample2.fs)
+		if(BUTTON_PRESSED == true)
+			frame_uniforms.setLight(light_pos, glm::vec3(0.1f), glm::vec3(0.8f), glm::vec3(1.0f), 0.0f);
+		else
+			frame_uniforms.setLight(light_pos, glm::vec3(0.1f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
 
-			glBindVertexArray(VAO_box);
+		// camera/view transformation
+		glm::mat4 view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
 
-			
-			
-			for(int tab = 0; tab < 3; tab++)
-			{	
-				if(tab == 0) // X
-				{
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, tex_red_diffuse);
-					glActiveTexture(GL_TEXTURE1);
-					glBindTexture(GL_TEXTURE_2D, tex_red_specular);
-				}
-				if(tab == 1) // Y
-				{
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, tex_green_diffuse);
-					glActiveTexture(GL_TEXTURE1);
-					glBindTexture(GL_TEXTURE_2D, tex_green_specular);
-				}
-				if(tab == 2) // Z
-				{
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, tex_blue_diffuse);
-					glActiveTexture(GL_TEXTURE1);
-					glBindTexture(GL_TEXTURE_2D, tex_blue_specular);
-				}
+		// upload camera and light state once for both programs
+		frame_uniforms.setCamera(projection, view, camera_pos);
+		frame_stream.beginFrame();
+		frame_uniforms.upload(frame_stream);
 
-				model = glm::mat4();
-				model = glm::scale(model, coord_scales[tab]);
+		//Animated nodes (static nodes were placed once before the render loop)
+		float red_button_height = 0.05f;
+		if(BUTTON_PRESSED == true) {red_button_height -= 0.02f;}
 
-				lighting_shader.setMat4("model", model);
+		scene.setPosition(button_nodes[1], glm::vec3(0.0f, red_button_height + 0.5f * button_scales[1].y, 0.0f));
 
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-		}
+		//transformation for animation, blended between the last two ticks
+		float curtin_translate = curtin_translate_y.at(alpha);
+		float curtin_rotate = curtin_rotate_y.at(alpha);
 
+		scene.setPosition(curtin_node, glm::vec3(0.0f, 0.9f + (0.1f * sin(curtin_translate * PI / 180.f)), -0.35f));
+		scene.setRotation(curtin_node, glm::angleAxis(glm::radians(curtin_rotate), glm::vec3(0.0f, 1.0f, 0.0f)));
 
-		//Street
-		glBindVertexArray(VAO_box);
+		//only nodes that changed are recomputed, and only their bounds refit
+		scene.update();
+		culler.update(scene);
+		culler.cull(projection * view);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex_street_diffuse);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex_street_specular);
 
-		model = glm::mat4();
-		model = glm::scale(model, glm::vec3(3.0f, 0.001f, 7.0f));
 
-		lighting_shader.setMat4("model", model);
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		//Draw objects
+		//------------------------------------------------------------------------------------------
 
+		//Queue every visible object, keyed by program, material layer and distance
+		profiler.begin(queue_section);
 
-		//Grass
-		glBindVertexArray(VAO_box);
+		toggle_button_distance(button_final_location);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex_grass_diffuse);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex_grass_specular);
+		scene_draws.clear();
+		render_queue.clear();
 
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(0.0f, -0.01f, 0.0f));
-		model = glm::scale(model, glm::vec3(7.0f, 0.001f, 7.0f));
+		auto queue_draw = [&](int node, int layer, unsigned int program)
+		{
+			float depth = glm::length(glm::vec3(scene.worldMatrix(node)[3]) - camera_pos) / view_distance;
+			SceneDraw draw = { node, layer, program };
 
-		lighting_shader.setMat4("model", model);
+			render_queue.push(drawKey(0, program, 0, 0, (unsigned int)layer, depth), (unsigned int)scene_draws.size());
+			scene_draws.push_back(draw);
+		};
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		//Coordinate System
+		if(SHOW_COORDINATE == true)
+		{
+			const int coord_layers[3] = { layer_red, layer_green, layer_blue };	// X, Y, Z
+			for(int tab = 0; tab < 3; tab++)
+			{
+				if(culler.visible(coord_nodes[tab])) queue_draw(coord_nodes[tab], coord_layers[tab], LIGHTING_PROGRAM);
+			}
+		}
 
+		//Street and grass
+		if(culler.visible(street_node)) queue_draw(street_node, layer_street, LIGHTING_PROGRAM);
+		if(culler.visible(grass_node)) queue_draw(grass_node, layer_grass, LIGHTING_PROGRAM);
 
 		//Table (4 tall boxes for legs & 1 thin box as table top)
-		glm::vec3 table_scales[] = {
-			glm::vec3( 1.0f,  0.1f,  1.0f),	//top
-			glm::vec3( 0.1f,  0.5f,  0.1f),//near left
-			glm::vec3( 0.1f,  0.5f,  0.1f),	//near right
-			glm::vec3( 0.1f,  0.5f,  0.1f),//far left
-			glm::vec3( 0.1f,  0.5f,  0.1f),	//far right
-		};
-		glm::vec3 table_positions[] = {
-			glm::vec3( 0.0f,  0.5f,  0.0f),		//top
-			glm::vec3(-0.45f, 0.0f,  0.45f),	//near left
-			glm::vec3( 0.45f, 0.0f,  0.45f),	//near right
-			glm::vec3(-0.45f, 0.0f, -0.45f),	//far left
-			glm::vec3( 0.45f, 0.0f, -0.45f),	//far right
-		};
+		for(int tab = 0; tab < 5; tab++)
+		{
+			if(culler.visible(table_nodes[tab])) queue_draw(table_nodes[tab], layer_wood, LIGHTING_PROGRAM);
+		}
 
-		glBindVertexArray(VAO_box);
+		//Button on table (1 big box & 1 small box as button)
+		if(culler.visible(button_nodes[0])) queue_draw(button_nodes[0], layer_marble, LIGHTING_PROGRAM);
+		if(culler.visible(button_nodes[1])) queue_draw(button_nodes[1], BUTTON_PRESSED ? layer_red_bright : layer_red_dark, LIGHTING_PROGRAM);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex_wood_diffuse);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex_wood_specular);
+		//Curtin Logo
+		if(culler.visible(curtin_node)) queue_draw(curtin_node, layer_curtin, LIGHTING_PROGRAM);
 
-		for(int tab = 0; tab < 5; tab++)
-		{	
-			model = glm::mat4();
-			model = glm::translate(model, table_positions[tab]);
-			model = glm::scale(model, table_scales[tab]);
-			model = glm::translate(model, glm::vec3(0.0f, 0.5f, 0.0f));
+		//The light source, with its own program
+		queue_draw(light_node, 0, LAMP_PROGRAM);
 
-			lighting_shader.setMat4("model", model);
+		render_queue.sort();
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
+		profiler.end(queue_section);
 
 
-		//Button on table (1 big box & 1 small box as button)
-		glm::vec3 button_scales[] = {
-			glm::vec3( 0.2f,  0.12f,  0.2f),		//case
-			glm::vec3( 0.12f,  0.12f,  0.12f),		//button
-		};
+		//Draw the queue, switching program and layer only where they change
+		profiler.begin(draw_section);
 
-		float red_button_height = 0.05f;
-		if(BUTTON_PRESSED == true) {red_button_height -= 0.02f;}
+		// every material lives in these two arrays, so they are bound once for the whole pass
+		glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, diffuse_array.ID);
+		glState().bindTexture(1, GL_TEXTURE_2D_ARRAY, specular_array.ID);
+		glState().bindVertexArray(mesh_pool.VAO);
 
-		glm::vec3 button_positions[] = {
-			glm::vec3( 0.0f,  0.0f,  0.0f),			//case
-			glm::vec3( 0.0f,  red_button_height,  0.0f),	//button
-		};
+		const std::vector<RenderQueueEntry> &queued = render_queue.entries();
+		int current_program = -1;
+		int current_layer = -1;
 
-		glm::vec3 button_final_location = glm::vec3(0.0f, 0.56f, 0.25f);
-		toggle_button_distance(button_final_location); 
-
-		glBindVertexArray(VAO_box);
-		
-		for(int tab = 0; tab < 2; tab++)
-		{	
-			glActiveTexture(GL_TEXTURE0);
-			if(tab == 0)
-			{	
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, tex_marble_diffuse);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, tex_marble_specular);
-			}
-			else
+		for(size_t q = 0; q < queued.size(); q++)
+		{
+			const SceneDraw &draw = scene_draws[queued[q].item];
+
+			if((int)draw.program != current_program)
 			{
-				if(BUTTON_PRESSED == false) 	// Not Pressed
+				current_program = (int)draw.program;
+				current_layer = -1;
+
+				if(draw.program == LIGHTING_PROGRAM)
 				{
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, tex_red_dark_diffuse);
-					glActiveTexture(GL_TEXTURE1);
-					glBindTexture(GL_TEXTURE_2D, tex_red_dark_specular);
+					glState().useProgram(lighting_shader.ID);
+					glUniform1f(lighting_shininess_location, 65.0f);
 				}
-				else				// Pressed
+				else
 				{
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, tex_red_bright_diffuse);
-					glActiveTexture(GL_TEXTURE1);
-					glBindTexture(GL_TEXTURE_2D, tex_red_bright_specular);
+					glState().useProgram(lamp_shader.ID);
+					glUniform1f(lamp_intensity_location, BUTTON_PRESSED ? 1.0f : 0.3f);
 				}
 			}
 
-			model = glm::mat4();
-			model = glm::translate(model, button_final_location);
-			model = glm::translate(model, button_positions[tab]);
-			model = glm::scale(model, button_scales[tab]);
-			model = glm::translate(model, glm::vec3(0.0f, 0.5f, 0.0f));
-
-			lighting_shader.setMat4("model", model);
-
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
-
-
-
-		//Curtin Logo
-		glBindVertexArray(VAO_box);
+			if(draw.program == LIGHTING_PROGRAM)
+			{
+				if(draw.layer != current_layer)
+				{
+					glUniform1i(lighting_layer_location, draw.layer);
+					current_layer = draw.layer;
+				}
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex_curtin_diffuse);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex_curtin_specular);
+				glUniformMatrix4fv(lighting_model_location, 1, GL_FALSE, &scene.worldMatrix(draw.node)[0][0]);
+				glUniformMatrix3fv(lighting_normal_matrix_location, 1, GL_FALSE, &scene.normalMatrix(draw.node)[0][0]);
+			}
+			else
+			{
+				glUniformMatrix4fv(lamp_model_location, 1, GL_FALSE, &scene.worldMatrix(draw.node)[0][0]);
+			}
 
-		//transformation for animation
-		if(BUTTON_PRESSED == true)
-		{
-			curtin_translate_y += 1.0f;
-			curtin_rotate_y += 1.0f;
-			if(abs(curtin_translate_y - 360.0f) <= 0.1f) curtin_translate_y = 0.0f;
-			if(abs(curtin_rotate_y - 360.0f) <= 0.1f) curtin_rotate_y = 0.0f;
+			box_mesh.draw();
 		}
 
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(0.0f, 0.9f + (0.1f * sin(curtin_translate_y * PI / 180.f)), -0.35f));
-		model = glm::rotate(model, glm::radians(curtin_rotate_y), glm::vec3(0.0f, 1.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.001f));
-
-		lighting_shader.setMat4("model", model);
-
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		profiler.end(draw_section);
 
 
 
-		// Draw the light source
-		lamp_shader.use();
-		lamp_shader.setMat4("projection", projection);
-		lamp_shader.setMat4("view", view);
-		model = glm::mat4();
-		model = glm::translate(model, light_pos);
-		model = glm::scale(model, glm::vec3(0.01f)); // a smaller cube
-		lamp_shader.setMat4("model", model);
-
-		
-		if(BUTTON_PRESSED == true) lamp_shader.setFloat("intensity", 1.0);
-		else lamp_shader.setFloat("intensity", 0.3);
-
-		glBindVertexArray(VAO_light);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-
 
 
 
 
 
+		// nothing after this reads this frame's part of the ring
+		frame_stream.endFrame();
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		if (benchmark.enabled)
+			benchmark.endFrame();
 	}
 
+	if (benchmark.enabled)
+		benchmark.writeReport("sample2", profiler);
+
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
-	glDeleteVertexArrays(1, &VAO_box);
-	glDeleteBuffers(1, &VBO_box);
+	glDeleteVertexArrays(1, &mesh_pool.VAO);
+	glDeleteBuffers(1, &mesh_pool.VBO);
+	glDeleteBuffers(1, &mesh_pool.IBO);
+	glDeleteBuffers(1, &frame_uniforms.UBO);
+	glDeleteBuffers(1, &frame_stream.ID);
+	frame_stream.deleteFences();
+	glDeleteBuffers(2, texture_loader.PBO);
+	glDeleteFramebuffers(2, diffuse_array.FBO);
+	glDeleteFramebuffers(2, specular_array.FBO);
+	glDeleteTextures(1, &diffuse_array.ID);
+	glDeleteTextures(1, &specular_array.ID);
+	profiler.deleteQueries();
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -555,47 +644,53 @@ int main()
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void process_input(GLFWwindow *window)
-	{
-    	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        	glfwSetWindowShouldClose(window, true);
-
-	float cameraSpeed;
+{
+	input.dispatch(glfwGetTime());
 
-	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_RELEASE)
-		cameraSpeed = 2.5 * delta_time; 
-	else
-		cameraSpeed = 2.5 * delta_time * 2;	// double speed with "Shift" pressed
+	if (input.pressed(INPUT_QUIT))
+		glfwSetWindowShouldClose(window, true);
 
+	// move for exactly as long as each key was held since the last frame
+	float speed = 2.5f;
+	if (input.down(INPUT_RUN))
+		speed *= 2;	// double speed with "Shift" pressed
 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		camera_pos += cameraSpeed * camera_front;
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		camera_pos -= cameraSpeed * camera_front;
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		camera_pos -= glm::normalize(glm::cross(camera_front, camera_up)) * cameraSpeed;
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		camera_pos += glm::normalize(glm::cross(camera_front, camera_up)) * cameraSpeed;
+	glm::vec3 camera_right = glm::normalize(glm::cross(camera_front, camera_up));
+	camera_pos += speed * input.heldFor(INPUT_FORWARD) * camera_front;
+	camera_pos -= speed * input.heldFor(INPUT_BACKWARD) * camera_front;
+	camera_pos -= speed * input.heldFor(INPUT_LEFT) * camera_right;
+	camera_pos += speed * input.heldFor(INPUT_RIGHT) * camera_right;
 
 
 	//toggle red button
-	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && BUTTON_DELAY == 0 && BUTTON_CLOSE_ENOUGH == true)
-	{
-		BUTTON_DELAY = 20;
-		if(BUTTON_PRESSED == false) 		
-			BUTTON_PRESSED = true;
-		else
-			BUTTON_PRESSED = false;
-	}
+	if (input.pressed(INPUT_BUTTON) % 2 && BUTTON_CLOSE_ENOUGH == true)
+		toggle_button();
+
+	//print the profiler report
+	if (input.pressed(INPUT_PROFILE))
+		PRINT_PROFILE = true;
 
 	//toggle coordinate visibility
-	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && SHOW_DELAY == 0)
-	{
-		SHOW_DELAY = 20;
-		if(SHOW_COORDINATE == false) 		
-			SHOW_COORDINATE = true;
-		else
-			SHOW_COORDINATE = false;
-	}
+	if (input.pressed(INPUT_COORDINATES) % 2)
+		toggle_coordinates();
+}
+
+// Flip the red button.
+void toggle_button()
+{
+	if(BUTTON_PRESSED == false) 		
+		BUTTON_PRESSED = true;
+	else
+		BUTTON_PRESSED = false;
+}
+
+// Show or hide the coordinate axes.
+void toggle_coordinates()
+{
+	if(SHOW_COORDINATE == false) 		
+		SHOW_COORDINATE = true;
+	else
+		SHOW_COORDINATE = false;
 }
 
 
@@ -607,41 +702,3 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	// height will be significantly larger than specified on retina displays.
 	glViewport(0, 0, width, height);
 }
-
-unsigned int loadTexture(char const * path)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
-}
@@ -2,8 +2,9 @@
 out vec4 FragColor;
 
 struct Material {
-    sampler2D diffuse;
-    sampler2D specular;    
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    int layer;              // same layer in both arrays
     float shininess;
 }; 
 
@@ -13,32 +14,41 @@ struct Light {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
+
+    float falloff;
 };
 
 in vec3 FragPos;  
 in vec3 Normal;  
 in vec2 TexCoords;
   
-uniform vec3 viewPos;
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    Light light;
+};
+
 uniform Material material;
-uniform Light light;
 
 void main()
 {
     // ambient
-    vec3 ambient = light.ambient * texture(material.diffuse, TexCoords).rgb;
+    vec3 ambient = light.ambient * texture(material.diffuse, vec3(TexCoords, material.layer)).rgb;
   	
     // diffuse 
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb;  
+    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, vec3(TexCoords, material.layer)).rgb;  
     
     // specular
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * spec * texture(material.specular, TexCoords).rgb;  
+    vec3 specular = light.specular * spec * texture(material.specular, vec3(TexCoords, material.layer)).rgb;  
         
     vec3 result = ambient + diffuse + specular;
     FragColor = vec4(result, 1.0);
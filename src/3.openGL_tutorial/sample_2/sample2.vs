@@ -7,14 +7,32 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
+struct Light {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float falloff;
+};
+
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    Light light;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix;	// computed once per object on the CPU
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
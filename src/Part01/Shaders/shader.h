@@ -7,8 +7,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <math.h>
 
+// Location of a uniform, resolved once when the program is linked
+struct UniformHandle
+{
+	GLint location;
+};
+
 class Shader
 {
 public:
@@ -103,6 +111,9 @@ public:
 		// delete shaders after they've been linked
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+
+		// cache uniform locations now rather than on every set* call
+		cacheUniformLocations();
 	}
 
 	// Method for using the shader
@@ -111,20 +122,86 @@ public:
 		glUseProgram(ID);
 	}
 
+	// Returns a handle to a uniform, or a handle the setters ignore if it is not active
+	UniformHandle uniform(const std::string &name) const
+	{
+		std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(name);
+		UniformHandle handle = { it != uniformLocations.end() ? it->second : -1 };
+		return handle;
+	}
+
 	// Utility uniform functions
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(uniform(name).location, (int)value);
+	}
+	void setBool(UniformHandle handle, bool value) const
+	{
+		glUniform1i(handle.location, (int)value);
 	}
 
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(uniform(name).location, value);
+	}
+	void setInt(UniformHandle handle, int value) const
+	{
+		glUniform1i(handle.location, value);
 	}
 
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(uniform(name).location, value);
+	}
+	void setFloat(UniformHandle handle, float value) const
+	{
+		glUniform1f(handle.location, value);
+	}
+
+private:
+	// Active uniform locations, filled in once after linking
+	std::unordered_map<std::string, GLint> uniformLocations;
+
+	// Queries every active uniform so the setters never have to ask the driver
+	void cacheUniformLocations()
+	{
+		int count = 0;
+		int maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+		for (int i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type;
+			glGetActiveUniform(ID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, &nameBuffer[0]);
+
+			std::string name(&nameBuffer[0], length);
+			GLint location = glGetUniformLocation(ID, name.c_str());
+
+			// members of uniform blocks have no location of their own
+			if (location < 0)
+				continue;
+
+			uniformLocations[name] = location;
+
+			// arrays are reported as "name[0]", so register the bare name and every element too
+			size_t bracket = name.rfind("[0]");
+			if (bracket != std::string::npos && bracket + 3 == name.size())
+			{
+				std::string base = name.substr(0, bracket);
+				uniformLocations[base] = location;
+
+				for (int j = 1; j < size; j++)
+				{
+					std::string element = base + "[" + std::to_string(j) + "]";
+					uniformLocations[element] = glGetUniformLocation(ID, element.c_str());
+				}
+			}
+		}
 	}
 };
 
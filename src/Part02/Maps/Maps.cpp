@@ -7,21 +7,52 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 
+#include "gl_state.h"
+#include "program_cache.h"
 #include "shader.h"
 #include "camera.h"
+#include "dynamic_buffer.h"
+#include "uniform_buffer.h"
+#include "mesh_library.h"
+#include "instancing.h"
+#include "scene_graph.h"
+#include "scene_file.h"
+#include "culling.h"
+#include "clustered_lights.h"
+#include "deferred.h"
+#include "point_shadow.h"
+#include "texture_loader.h"
+#include "texture_array.h"
+#include "profiler.h"
+#include "benchmark.h"
+#include "fixed_timestep.h"
+#include "input.h"
+#include "job_pool.h"
+#include "render_commands.h"
+#include "command_replay.h"
 #include <learnopengl/filesystem.h>
 
 #include <iostream>
+#include <algorithm>
 #include <math.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
-unsigned int loadTexture(const char *path);
+void toggleDoor();
+void toggleLantern();
+void simulate(float dt);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+// Lantern shadows: cube face size (changed with 9 and 0) and how far they reach
+unsigned int shadowResolution = 512;
+const float SHADOW_FAR = 25.0f;
 
 // Initial camera position
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -36,6 +67,11 @@ float lastY = SCR_HEIGHT / 2.0f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// Animation runs at a fixed 60 ticks per second and is drawn blended between
+// the last two ticks, so the frame rate (capped by vsync or not) doesn't change it
+FixedTimestep simClock(60.0f);
+bool vsync = true;
+
 // Lighting
 glm::vec3 lightPos(0.0f, -0.0f, 0.5f);
 float lightradius = 5.0f;
@@ -43,37 +79,59 @@ bool fulllight = false;
 
 // Jump height
 bool jumping = false;
-float jumpFrame = 0.0f;
+float jumpPhase = 0.0f;
+Interpolated<float> jumpHeight(0.0f);
+
+// Ghost orbit angle and bob
+Interpolated<float> ghostAngle(0.0f);
+Interpolated<float> ghostBob(0.0f);
 
 // Door animation
-float animFrame = 0.0f;
+Interpolated<float> doorAngle(0.0f);
 bool doorOpen = false;
 bool doorOpening = false;
 bool doorClosing = false;
+glm::vec3 doorPosition;	// of the hinge, read from the scene every frame
 
 // Projection type
 bool ortho = false;
 
-// Key statuses
-bool pheld = false;
-bool kheld = false;
-bool lheld = false;
-bool oheld = false;
-bool fheld = false;
-bool zoominheld = false;
-bool zoomoutheld = false;
+// Keyboard events from GLFW's callbacks, and what each key does
+InputSystem input;
+
+enum InputActions
+{
+	INPUT_QUIT, INPUT_FORWARD, INPUT_BACKWARD, INPUT_TURN_LEFT, INPUT_TURN_RIGHT, INPUT_LOOK_UP, INPUT_LOOK_DOWN,
+	INPUT_JUMP, INPUT_PROJECTION, INPUT_RADIUS_UP, INPUT_RADIUS_DOWN, INPUT_FULL_LIGHT, INPUT_SHADOW_DOWN, INPUT_SHADOW_UP,
+	INPUT_ZOOM_OUT, INPUT_ZOOM_IN, INPUT_LANTERN, INPUT_PROFILE, INPUT_DEFERRED, INPUT_VSYNC, INPUT_DOOR
+};
+
+// Profiler report requested with t
+bool printProfile = false;
+
+// Deferred shading instead of forward, toggled with g
+bool deferredShading = false;
 
 // Lantern state
 bool holdingLantern = false;
 
-int main()
+// Actions the benchmark script can trigger
+enum BenchmarkActions { ACTION_TOGGLE_DOOR, ACTION_TOGGLE_LANTERN };
+
+int main(int argc, char **argv)
 {
+	// --benchmark runs a scripted, headless session instead (see benchmark.h)
+	Benchmark benchmark;
+	if (!benchmark.parse(argc, argv))
+		return -1;
+
    	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	benchmark.windowHints();
 
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
@@ -91,6 +149,22 @@ int main()
 	glfwMakeContextCurrent(window);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
+	const int keyBindings[][2] = {
+		{ GLFW_KEY_ESCAPE, INPUT_QUIT },
+		{ GLFW_KEY_W, INPUT_FORWARD }, { GLFW_KEY_S, INPUT_BACKWARD },
+		{ GLFW_KEY_A, INPUT_TURN_LEFT }, { GLFW_KEY_D, INPUT_TURN_RIGHT },
+		{ GLFW_KEY_Q, INPUT_LOOK_UP }, { GLFW_KEY_E, INPUT_LOOK_DOWN },
+		{ GLFW_KEY_SPACE, INPUT_JUMP }, { GLFW_KEY_P, INPUT_PROJECTION },
+		{ GLFW_KEY_L, INPUT_RADIUS_UP }, { GLFW_KEY_K, INPUT_RADIUS_DOWN }, { GLFW_KEY_O, INPUT_FULL_LIGHT },
+		{ GLFW_KEY_9, INPUT_SHADOW_DOWN }, { GLFW_KEY_0, INPUT_SHADOW_UP },
+		{ GLFW_KEY_1, INPUT_ZOOM_OUT }, { GLFW_KEY_3, INPUT_ZOOM_IN },
+		{ GLFW_KEY_F, INPUT_LANTERN }, { GLFW_KEY_T, INPUT_PROFILE }, { GLFW_KEY_G, INPUT_DEFERRED },
+		{ GLFW_KEY_V, INPUT_VSYNC }, { GLFW_KEY_R, INPUT_DOOR }
+	};
+	for (size_t k = 0; k < sizeof(keyBindings) / sizeof(keyBindings[0]); k++)
+		input.bind(keyBindings[k][0], keyBindings[k][1]);
+	input.attach(window);
+
 	// glad: load all OpenGL function pointers
 	// ---------------------------------------
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -99,209 +173,455 @@ int main()
 		return -1;
 	}
 
+	// the benchmark measures throughput, so it must not wait for vsync
+	if (benchmark.enabled)
+		vsync = false;
+	glfwSwapInterval(vsync ? 1 : 0);
+
 	// configure global opengl state
 	// -----------------------------
-	glEnable(GL_DEPTH_TEST);
+	glState().setEnabled(GL_DEPTH_TEST, true);
 
 	// build and compile our shader zprogram
 	// ------------------------------------
-	Shader lightingShader("maplighting.vs", "flatlighting.fs");
-	Shader lampShader("lamp.vs", "lamp.fs");
+	// programs linked by earlier runs are loaded as binaries; the rest all start
+	// compiling before any is waited for, so the driver can build them side by side
+	ProgramCache programCache("shader_cache");
+
+	Shader lightingShader("maplighting.vs", "flatlighting.fs", NULL, &programCache);
+	Shader lampShader("lamp.vs", "lamp.fs", NULL, &programCache);
+
+	// the deferred path: G-buffer fill, then the ambient and light volume passes
+	Shader gbufferShader("maplighting.vs", "gbuffer.fs", NULL, &programCache);
+	Shader ambientShader("fullscreen.vs", "deferred_ambient.fs", NULL, &programCache);
+	Shader lightVolumeShader("light_volume.vs", "light_volume.fs", NULL, &programCache);
+
+	// lantern shadow cube, all six faces in one pass
+	Shader shadowShader("shadow_depth.vs", "shadow_depth.fs", "shadow_depth.gs", &programCache);
+
+	Shader *allShaders[6] = { &lightingShader, &lampShader, &gbufferShader, &ambientShader, &lightVolumeShader, &shadowShader };
+	for (int s = 0; s < 6; s++)
+		allShaders[s]->finish();
+
+	// per-frame camera/light block shared by every program
+	FrameUniforms frameUniforms;
+	frameUniforms.attach(lightingShader.ID);
+	frameUniforms.attach(lampShader.ID);
+	frameUniforms.attach(gbufferShader.ID);
+	frameUniforms.attach(ambientShader.ID);
+	frameUniforms.attach(lightVolumeShader.ID);
 
 	// set up vertex data (and buffer(s)) and configure vertex attributes
 	// ------------------------------------------------------------------
-	float vertices[] = {
-		// positions          // normals           // texture coords
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
-	};
+	// every mesh is generated at compile time (see mesh_library.h) and shares
+	// one vertex and one index buffer, packed to 20 bytes per vertex; the face
+	// cube maps the front face to the top half of its texture and the other
+	// faces to the bottom half
+	MeshPool meshPool;
+	Mesh sceneMeshes[SCENE_MESH_COUNT];
+	sceneMeshes[SCENE_MESH_NONE] = Mesh();
+	sceneMeshes[SCENE_MESH_CUBE] = meshPool.add(CUBE_MESH);
+	sceneMeshes[SCENE_MESH_FACE] = meshPool.add(FACE_CUBE_MESH);
+	sceneMeshes[SCENE_MESH_PLANE] = meshPool.add(PLANE_MESH);
+	sceneMeshes[SCENE_MESH_CYLINDER] = meshPool.add(CYLINDER_MESH);
+	sceneMeshes[SCENE_MESH_SPHERE] = meshPool.add(SPHERE_MESH);
+	meshPool.build();
+
+	// the lamp is drawn with the plain cube from the same pool
+	const Mesh &lampMesh = sceneMeshes[SCENE_MESH_CUBE];
+
+	// per-instance model matrices and material indices for every mesh in the pool
+	InstanceRenderer instanceRenderer;
+	instanceRenderer.attach(meshPool.VAO);
+
+	// instance data and the FrameData block are written straight into a
+	// persistently mapped ring, a region per frame in flight (see dynamic_buffer.h)
+	DynamicBuffer frameStream(256 * 1024);
+	instanceRenderer.useDynamicBuffer(&frameStream);
+
+	// draws are recorded as commands on worker threads and replayed here;
+	// mesh handles are the SCENE_MESH_* numbers
+	CommandReplay commandReplay(instanceRenderer);
+	for (int m = 0; m < SCENE_MESH_COUNT; m++)
+		commandReplay.addMesh(sceneMeshes[m]);
+
+	lightingShader.use();
+	lightingShader.setInt("diffuseMaps", 0);
+	lightingShader.setInt("pointLights", POINT_LIGHTS_UNIT);
+	lightingShader.setInt("lightClusters", LIGHT_CLUSTERS_UNIT);
+	lightingShader.setInt("lightIndices", LIGHT_INDICES_UNIT);
+
+	gbufferShader.use();
+	gbufferShader.setInt("diffuseMaps", 0);
+
+	Shader *lightPassShaders[2] = { &ambientShader, &lightVolumeShader };
+	for (int s = 0; s < 2; s++)
+	{
+		lightPassShaders[s]->use();
+		lightPassShaders[s]->setInt("gAlbedo", GBUFFER_ALBEDO_UNIT);
+		lightPassShaders[s]->setInt("gNormal", GBUFFER_NORMAL_UNIT);
+		lightPassShaders[s]->setInt("gDepth", GBUFFER_DEPTH_UNIT);
+	}
+	lightVolumeShader.setInt("pointLights", POINT_LIGHTS_UNIT);
+
+	Shader *shadowedShaders[2] = { &lightingShader, &ambientShader };
+	for (int s = 0; s < 2; s++)
+	{
+		shadowedShaders[s]->use();
+		shadowedShaders[s]->setInt("shadowMap", SHADOW_MAP_UNIT);
+		shadowedShaders[s]->setFloat("shadowFar", SHADOW_FAR);
+	}
 
-	float faceTexture[36 * 8];	
-	
-	int i;	
-	for (i = 0; i < 36 * 8; i++)
+	shadowShader.use();
+	shadowShader.setFloat("shadowFar", SHADOW_FAR);
+
+	PointShadow lanternShadow(shadowResolution, SHADOW_FAR);
+
+	// light volumes are spheres from the same pool
+	DeferredRenderer deferredRenderer(meshPool, sceneMeshes[SCENE_MESH_SPHERE]);
+
+	// ==================== LOADING TEXTURES =======================
+	// Images decode on worker threads and appear once uploaded; until then
+	// each texture shows a placeholder, so startup doesn't wait on them
+	// textures baked by TextureBake upload straight from the pack, without decoding
+	TexturePack texturePack;
+	TextureLoader textureLoader;
+
+	if (texturePack.open(FileSystem::getPath("resources/textures.pack")))
+		textureLoader.usePack(&texturePack);
+
+	// ==================== SCENE =======================
+	// The layout lives in ghosthouse.scene; after the first run it is read
+	// from the binary cache next to it without any parsing.
+	SceneFile sceneFile;
+	if (!sceneFile.load("ghosthouse.scene"))
 	{
-		faceTexture[i] = vertices[i];
+		glfwTerminate();
+		return -1;
 	}
 
-	for (i = 7; i < 48; i = i + 8)
+	// material table uploaded once; every instance refers to it by index
+	unsigned int i;
+	for (i = 0; i < sceneFile.materialCount(); i++)
 	{
-		if (faceTexture[i] == 0.0f)
-			faceTexture[i] = 0.5f;
+		const SceneMaterialRecord &material = sceneFile.material(i);
+		std::string name = "materials[" + std::to_string(i) + "]";
+		lightingShader.use();
+		lightingShader.setVec3(name + ".ambient", glm::make_vec3(material.ambient));
+		lightingShader.setVec3(name + ".specular", glm::make_vec3(material.specular));
+		lightingShader.setFloat(name + ".shininess", material.shininess);
+		gbufferShader.use();
+		gbufferShader.setVec3(name + ".ambient", glm::make_vec3(material.ambient));
+		gbufferShader.setVec3(name + ".specular", glm::make_vec3(material.specular));
+		gbufferShader.setFloat(name + ".shininess", material.shininess);
 	}
 
-	for (i = 55; i < 36 * 8; i = i + 8)
+	// every scene texture becomes a layer of one array, so the whole scene draws with a
+	// single binding; the layers are as large as the largest texture
+	int layerWidth = 1, layerHeight = 1;
+	for (i = 0; i < sceneFile.textureCount(); i++)
 	{
-		if (faceTexture[i] == 0.0f)
-			faceTexture[i] = 0.5f;
-		if (faceTexture[i] == 1.0f)
-			faceTexture[i] = 0.0f;
+		int width, height;
+		if (textureLoader.imageSize(FileSystem::getPath(sceneFile.texture(i).path), width, height))
+		{
+			layerWidth = std::max(layerWidth, width);
+			layerHeight = std::max(layerHeight, height);
+		}
 	}
 
-	// ================= CUBE ===============
-	// Configure the cube's VAO & VBO
-	unsigned int VBO, cubeVAO;
-	glGenVertexArrays(1, &cubeVAO);
-	glGenBuffers(1, &VBO);
+	TextureArray diffuseArray(layerWidth, layerHeight, sceneFile.textureCount());
+
+	std::vector<int> sceneLayers;
+	for (i = 0; i < sceneFile.textureCount(); i++)
+		sceneLayers.push_back(diffuseArray.load(textureLoader, FileSystem::getPath(sceneFile.texture(i).path)));
+
+	// Static transforms are computed once by the scene graph; only the
+	// animated nodes change per frame. Node order is draw order.
+	const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	SceneGraph scene;
 
-	glBindVertexArray(cubeVAO);
+	// world-space bounds of every drawable, kept in a BVH for frustum culling
+	SceneCuller culler;
 
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	
-	// normal attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3*sizeof(float)));
-	glEnableVertexAttribArray(1);
+	for (i = 0; i < sceneFile.nodeCount(); i++)
+	{
+		const SceneNodeRecord &record = sceneFile.node(i);
+		glm::vec3 position = glm::make_vec3(record.position);
+		glm::quat rotation(record.rotation[0], record.rotation[1], record.rotation[2], record.rotation[3]);
+		glm::vec3 scale = glm::make_vec3(record.scale);
+
+		if (record.mesh == SCENE_MESH_NONE)
+			scene.addNode(record.parent, position, rotation, scale);
+		else
+			culler.add(scene.addDrawable(record.parent, sceneMeshes[record.mesh], diffuseArray.ID, record.material, sceneLayers[record.texture], position, rotation, scale), AABB(sceneMeshes[record.mesh]), record.cell);
+	}
 
-	// texture attribute
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
-	glEnableVertexAttribArray(2);
+	// rooms and the doorways between them; what lies in a cell no open doorway leads to is never drawn
+	PortalVisibility portals;
 
-	// ================= LIGHT ==================
-	// Configure the light's VAO & VBO
-	unsigned int lightVAO;
-	glGenVertexArrays(1, &lightVAO);
-	glBindVertexArray(lightVAO);
+	// portals with a door, open while the door's node is turned away from how the file placed it
+	struct DoorPortal
+	{
+		int portal;
+		int door;
+		glm::quat closed;
+	};
+	std::vector<DoorPortal> doorPortals;
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	for (i = 0; i < sceneFile.cellCount(); i++)
+		portals.addCell(AABB(glm::make_vec3(sceneFile.cell(i).min), glm::make_vec3(sceneFile.cell(i).max)));
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+	for (i = 0; i < sceneFile.portalCount(); i++)
+	{
+		const ScenePortalRecord &record = sceneFile.portal(i);
+		glm::vec3 corners[4];
+		for (int c = 0; c < 4; c++)
+			corners[c] = glm::make_vec3(record.corners[c]);
 
-	// ================== FACE ===================
-	// Configure the VAO & VBO for a cube with a forward-facing texture
-	unsigned int faceVAO, faceVBO;
-	glGenVertexArrays(1, &faceVAO);
-	glGenBuffers(1, &faceVBO);
-	glBindVertexArray(faceVAO);
+		int portal = portals.addPortal(record.cells[0], record.cells[1], corners);
+		if (record.door[0] == '\0')
+			continue;
 
-	glBindBuffer(GL_ARRAY_BUFFER, faceVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(faceTexture), faceTexture, GL_STATIC_DRAW);
-	
-	glBindVertexArray(faceVAO);
+		int door = sceneFile.findAnimated(record.door);
+		if (door < 0)
+		{
+			std::cout << "ERROR::SCENE::PORTAL_DOOR_NOT_FOUND " << record.name << std::endl;
+			glfwTerminate();
+			return -1;
+		}
 
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+		const float *rotation = sceneFile.node(door).rotation;
+		DoorPortal doorPortal = { portal, door, glm::quat(rotation[0], rotation[1], rotation[2], rotation[3]) };
+		doorPortals.push_back(doorPortal);
+	}
 
-	// normal attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3*sizeof(float)));
-	glEnableVertexAttribArray(1);
+	// candles and lanterns around the house, on top of the one the player carries
+	ClusteredLights pointLights;
 
-	// texture attribute
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
-	glEnableVertexAttribArray(2);
+	for (i = 0; i < sceneFile.lightCount(); i++)
+	{
+		const SceneLightRecord &record = sceneFile.light(i);
+		PointLight light = { glm::make_vec3(record.position), glm::make_vec3(record.diffuse), glm::make_vec3(record.specular),
+			record.falloff, record.attenuation[0], record.attenuation[1], record.attenuation[2] };
+		pointLights.add(light);
+	}
 
-	lightingShader.use();
-	lightingShader.setInt("material.diffuse", 0);
+	// nodes the render loop animates
+	int ghostPivot = sceneFile.findAnimated("ghost_orbit");
+	int ghostBody = sceneFile.findAnimated("ghost_bob");
+	int doorHinge = sceneFile.findAnimated("door_hinge");
+	int lantern = sceneFile.findAnimated("lantern");
 
-	// ==================== LOADING TEXTURES =======================
-	unsigned int diffuseMap = loadTexture(FileSystem::getPath("resources/textures/container2.png").c_str());
-	unsigned int specularMap = loadTexture(FileSystem::getPath("resources/textures/container2_specular.png").c_str());
-	unsigned int marble = loadTexture(FileSystem::getPath("resources/textures/marble2.jpg").c_str());
-	unsigned int nothing = loadTexture(FileSystem::getPath("resources/textures/nothing.png").c_str());
-	unsigned int booface = loadTexture(FileSystem::getPath("resources/textures/booface.jpg").c_str());
-	unsigned int white = loadTexture(FileSystem::getPath("resources/textures/white.png").c_str());
-	unsigned int bricks = loadTexture(FileSystem::getPath("resources/textures/brickwall.jpg").c_str());
-	unsigned int painting = loadTexture(FileSystem::getPath("resources/textures/ghost_clouds.jpg").c_str());
-	unsigned int wood = loadTexture(FileSystem::getPath("resources/textures/wood2.jpg").c_str());
-	unsigned int door = loadTexture(FileSystem::getPath("resources/textures/door2.jpg").c_str());
-	unsigned int corridor = loadTexture(FileSystem::getPath("resources/textures/corridor2.png").c_str());
-
-	// Get time at start of render loop
-	float startFrame = glfwGetTime();
+	if (ghostPivot < 0 || ghostBody < 0 || doorHinge < 0 || lantern < 0)
+	{
+		glfwTerminate();
+		return -1;
+	}
+
+	glm::vec3 ghostHome = glm::make_vec3(sceneFile.node(ghostBody).position);
+	const float *hingeRotation = sceneFile.node(doorHinge).rotation;
+	glm::quat doorClosed(hingeRotation[0], hingeRotation[1], hingeRotation[2], hingeRotation[3]);
+
+	// Shadow casters by how they move: the ghost always does, the door only
+	// while it swings, and everything else never, so it stays in the cache
+	std::vector<int> staticCasters, ghostCasters, doorCasters;
+
+	for (i = 0; i < sceneFile.nodeCount(); i++)
+	{
+		if (sceneFile.node(i).mesh == SCENE_MESH_NONE)
+			continue;
+
+		int root = i;
+		while (root != ghostPivot && root != doorHinge && sceneFile.node(root).parent >= 0)
+			root = sceneFile.node(root).parent;
+
+		if (root == ghostPivot)
+			ghostCasters.push_back(i);
+		else if (root == doorHinge)
+			doorCasters.push_back(i);
+		else
+			staticCasters.push_back(i);
+	}
+
+	bool doorWasMoving = false;
+
+	// Each frame's draws are recorded on the job pool: the static and moving
+	// shadow casters into one buffer each, and the visible scene split over
+	// one buffer per thread. Each buffer is sorted by draw key, so the replay
+	// groups draws by texture and mesh and runs them front to back.
+	JobPool jobs;
+	CommandBuffer shadowCommands[2];
+	const unsigned int sceneCommandCount = jobs.concurrency();
+	std::vector<CommandBuffer> sceneCommands(sceneCommandCount);
+	std::vector<const CommandBuffer*> sceneCommandPointers;
+	for (unsigned int b = 0; b < sceneCommandCount; b++)
+		sceneCommandPointers.push_back(&sceneCommands[b]);
+
+	// Records a node's draw, keyed by its state and its distance from the viewer over range
+	auto recordNode = [&](CommandBuffer &commands, const glm::vec3 &viewer, float range, int n)
+	{
+		const InstanceIndices &indices = scene.instanceIndices()[n];
+		const glm::mat4 &model = scene.worldMatrix(n);
+		unsigned int mesh = sceneFile.node(n).mesh;
+		unsigned int texture = scene.node(n).texture;
+
+		float depth = glm::length(glm::vec3(model[3]) - viewer) / range;
+		unsigned long long key = drawKey(0, 0, texture, mesh, (unsigned int)indices.material, depth);
+		commands.draw(key, mesh, texture, model, scene.normalMatrix(n), indices.material, indices.layer);
+	};
+	lightPos = glm::make_vec3(sceneFile.node(lantern).position);
+
+	// Look up the uniforms set every frame once, so the render loop never builds strings
+	UniformHandle lampModelUniform = lampShader.uniform("model");
+	UniformHandle clusterParamsUniform = lightingShader.uniform("clusterParams");
+	UniformHandle ambientInverseUniform = ambientShader.uniform("inverseViewProjection");
+	UniformHandle volumeInverseUniform = lightVolumeShader.uniform("inverseViewProjection");
+	UniformHandle shadowLightUniform = shadowShader.uniform("shadowLightPos");
+	UniformHandle shadowMatrixUniforms[6];
+	for (i = 0; i < 6; i++)
+		shadowMatrixUniforms[i] = shadowShader.uniform("shadowMatrices[" + std::to_string(i) + "]");
+
+	// CPU and GPU time of each part of the frame; press t for a report
+	Profiler profiler(benchmark.enabled ? benchmark.frameCount : 300);
+	int texturesSection = profiler.section("textures");
+	int ghostSection = profiler.section("ghost");
+	int doorSection = profiler.section("door");
+	int lanternSection = profiler.section("lantern");
+	int recordSection = profiler.section("record commands");
+	int lightsSection = profiler.section("light clusters");
+	int sceneUpdateSection = profiler.section("scene update");
+	int shadowSection = profiler.section("shadows");
+	int sceneDrawSection = profiler.section("scene draw");
+	int deferredSection = profiler.section("deferred lighting");
+	int lampSection = profiler.section("lamp");
+
+	if (benchmark.enabled)
+	{
+		// every run starts with all textures in place, so frames are comparable
+		unsigned int remaining;
+		do
+		{
+			remaining = textureLoader.update(~0u);
+			diffuseArray.refresh(textureLoader.uploaded());
+		} while (remaining > 0);
+
+		// walk in, take the lantern, open and close the door, then look around the room
+		benchmark.addCameraKey(0.0f, glm::vec3(0.0f, 0.0f, 3.0f), -90.0f, 0.0f);
+		benchmark.addCameraKey(2.0f, glm::vec3(0.0f, 0.0f, 1.5f), -90.0f, -10.0f);
+		benchmark.addCameraKey(5.0f, glm::vec3(1.6f, 0.0f, 0.2f), 0.0f, 0.0f);
+		benchmark.addCameraKey(8.0f, glm::vec3(1.6f, 0.0f, 0.2f), 0.0f, 0.0f);
+		benchmark.addCameraKey(11.0f, glm::vec3(-1.5f, 0.5f, -1.5f), 45.0f, 10.0f);
+		benchmark.addCameraKey(14.0f, glm::vec3(0.0f, 0.8f, 2.5f), -90.0f, 15.0f);
+
+		benchmark.addAction(2.0f, ACTION_TOGGLE_LANTERN);
+		benchmark.addAction(5.0f, ACTION_TOGGLE_DOOR);
+		benchmark.addAction(9.0f, ACTION_TOGGLE_DOOR);
+		benchmark.addAction(12.0f, ACTION_TOGGLE_LANTERN);
+	}
 
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		// in benchmark mode the clock advances by a fixed step per frame
+		if (benchmark.enabled && !benchmark.beginFrame())
+			break;
+
+		// the benchmark's own clock, not glfwGetTime() read a moment after it was
+		// set, so every run splits its frames into the same simulation ticks
+		float currentFrame = benchmark.enabled ? benchmark.time() : (float)glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+
+		profiler.beginFrame();
+		glState().beginFrame();
 		
 		// input
 		// -----
-		processInput(window);
+		if (!benchmark.enabled)
+		{
+			processInput(window);
+		}
+		else
+		{
+			// keys are ignored, but the queue must still be emptied
+			input.dispatch(currentFrame);
 
-		// render
-		// ------
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // also clear the depth buffer now!
+			glm::vec3 position;
+			float yaw, pitch;
+			benchmark.camera(position, yaw, pitch);
+			camera.SetView(position, yaw, pitch);
 
-		// activate lighting shader
-		lightingShader.use();
-		
-		// set light and camera positions
-		lightingShader.setVec3("light.position", lightPos);
-		lightingShader.setVec3("viewPos", camera.Position);
+			std::vector<int> actions = benchmark.dueActions();
+			for (size_t a = 0; a < actions.size(); a++)
+			{
+				if (actions[a] == ACTION_TOGGLE_DOOR)
+					toggleDoor();
+				else if (actions[a] == ACTION_TOGGLE_LANTERN)
+					toggleLantern();
+			}
+		}
 
-		// set light source radius
-		lightingShader.setFloat("light.falloff", lightradius);
+		// run the simulation ticks this frame owes
+		simClock.advance(deltaTime);
+		while (simClock.tick())
+			simulate(simClock.step());
 
-		// set lighting brightness
-		if (!fulllight)
+		// how far between the last two ticks this frame is drawn
+		float alpha = simClock.alpha();
+
+		if (printProfile)
 		{
-			lightingShader.setVec3("light.ambient", 0.2f, 0.2f, 0.2f);
-			lightingShader.setVec3("light.diffuse", 0.7f, 0.7f, 0.7f);
-			lightingShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
+			profiler.report(std::cout);
+			std::cout << "culling: " << culler.stats.visible << " of " << culler.stats.objects << " objects visible, "
+				<< culler.stats.nodeTests << " BVH nodes tested, " << culler.stats.refitted << " bounds refit" << std::endl;
+			std::cout << "portals: " << portals.stats.visibleCells << " of " << portals.cellCount() << " cells visible, "
+				<< portals.stats.portalsTested << " portals tested, " << culler.stats.portalCulled << " objects hidden behind them" << std::endl;
+			std::cout << "lights: " << pointLights.stats.lights << " of " << pointLights.size() << " in view, "
+				<< pointLights.stats.assignments << " cluster entries, at most " << pointLights.stats.maxPerCluster << " per cluster" << std::endl;
+			std::cout << "shadows: " << lanternShadow.resolution() << " pixel cube faces, static casters redrawn "
+				<< lanternShadow.stats.staticRedraws << " times so far" << std::endl;
+			std::cout << "commands: " << commandReplay.stats.commands << " replayed, " << commandReplay.stats.draws << " of them draws, recorded on "
+				<< jobs.concurrency() << " threads" << std::endl;
+			std::cout << "streaming: " << (frameStream.persistent() ? "persistent mapping" : "orphaning") << ", " << frameStream.frameSize() / 1024
+				<< " KB per frame, " << frameStream.stats.fenceWaits << " fence waits, " << frameStream.stats.overflows << " overflows so far" << std::endl;
+			std::cout << "programs: " << programCache.stats.hits << " loaded from the cache, " << programCache.stats.misses << " compiled"
+				<< (programCache.parallelCompile() ? " in parallel" : "") << " at startup" << std::endl;
+			std::cout << "state: " << glState().lastFrame.calls << " GL state calls made, " << glState().lastFrame.elided
+				<< " redundant ones skipped last frame" << std::endl;
+			printProfile = false;
 		}
-		else
+
+		// swap in any textures that finished decoding
 		{
-			lightingShader.setVec3("light.ambient", 1.0f, 1.0f, 1.0f);
-			lightingShader.setVec3("light.diffuse", 0.0f, 0.0f, 0.0f);
-			lightingShader.setVec3("light.specular", 0.0f, 0.0f, 0.0f);
+			ProfileScope scope(profiler, texturesSection);
+			textureLoader.update();
+			diffuseArray.refresh(textureLoader.uploaded());
 		}
 
+		// render
+		// ------
+		const float clearColour[4] = { 0.1f, 0.1f, 0.1f, 1.0f };
+		glClearColor(clearColour[0], clearColour[1], clearColour[2], clearColour[3]);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // also clear the depth buffer now!
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+
+		// set light position, radius and brightness
+		if (!fulllight)
+			frameUniforms.setLight(lightPos, glm::vec3(0.2f), glm::vec3(0.7f), glm::vec3(1.0f), lightradius);
+		else
+			frameUniforms.setLight(lightPos, glm::vec3(1.0f), glm::vec3(0.0f), glm::vec3(0.0f), lightradius);
+
 		glm::mat4 projection, view;
 		
 		// view/projection transformations
 		if (!ortho)
-			projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+			projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
 		else
-			projection = glm::ortho( -2.0f, 2.0f, -2.0f, 2.0f, 0.1f, 100.0f);
+			projection = glm::ortho( -2.0f, 2.0f, -2.0f, 2.0f, NEAR_PLANE, FAR_PLANE);
 
 		if (!ortho)
 			view = camera.GetViewMatrix();
@@ -313,304 +633,242 @@ int main()
 			);
 
 		// process jump
-		if (jumping)
-		{
-			glm::vec3 jumpHeight = glm::vec3(0.0f, glm::sin(3 * (jumpFrame - currentFrame)), 0.0f);
+		view = glm::translate(view, glm::vec3(0.0f, jumpHeight.at(alpha), 0.0f));
 
-			if (3 * (jumpFrame - currentFrame) <= -M_PI)
-			{
-				jumpHeight.y = 0.0f;
-				jumping = false;
-			}
-
-			view = glm::translate(view, jumpHeight);
-		}
-
-		lightingShader.setMat4("projection", projection);
-		lightingShader.setMat4("view", view);
+		// upload camera and light state once for every program
+		frameUniforms.setCamera(projection, view, camera.Position);
+		frameStream.beginFrame();
+		frameUniforms.upload(frameStream);
 
 		// ========== GHOST ===========
-		// initialise ghost transformation
-		float ghostBob = 0.2f * glm::sin(currentFrame * 4);
-		glm::mat4 ghostTransform = glm::rotate(glm::mat4(), startFrame - currentFrame, glm::vec3(0.0f, 1.0f, 0.0f));
-		ghostTransform = glm::translate(ghostTransform, glm::vec3(2.0f, 1.2f + ghostBob, 0.0f));
-		ghostTransform = glm::scale(ghostTransform, glm::vec3(0.7f, 0.7f, 0.7f));
-		
-		glm::mat4 model = ghostTransform;
-
-		// set material properties
-		lightingShader.setVec3("material.ambient", 0.3f, 0.3f, 0.3f);
-		lightingShader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-		lightingShader.setFloat("material.shininess", 32.0f);
-
-		// bind diffuse map
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, booface);
-
-		// bind specular map
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, nothing);
-
-		// render the spooky ghost
-		glBindVertexArray(faceVAO);
-		lightingShader.setMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		{
+			ProfileScope scope(profiler, ghostSection);
+			scene.setRotation(ghostPivot, glm::angleAxis(ghostAngle.at(alpha), yAxis));
+			scene.setPosition(ghostBody, ghostHome + glm::vec3(0.0f, ghostBob.at(alpha), 0.0f));
+		}
 
-		// render the spooky ghost's spooky arms
-		glBindVertexArray(cubeVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, white);
+		// ========== DOOR ===========
+		{
+			ProfileScope scope(profiler, doorSection);
 
-		model = ghostTransform;
-		model = glm::scale(model, glm::vec3(1.6f, 0.3f, 0.3f));
+			// the swing is on top of how the file placed the hinge, so a shut
+			// door (no swing) has exactly the file's rotation again
+			float angle = doorAngle.at(alpha);
+			scene.setRotation(doorHinge, doorClosed * glm::angleAxis(angle, yAxis));
 
-		lightingShader.setMat4("model", model);
+			// a doorway can be seen through from the moment its door starts to open
+			for (size_t p = 0; p < doorPortals.size(); p++)
+				portals.setOpen(doorPortals[p].portal, scene.node(doorPortals[p].door).rotation != doorPortals[p].closed);
+		}
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		// set lantern position
+		{
+			ProfileScope scope(profiler, lanternSection);
 
-		// render the spooky ghost's spooky tail
-		model = ghostTransform;
-		model = glm::translate(model, glm::vec3(0.0f, -0.35f, -0.151f));
-		model = glm::scale(model, glm::vec3(0.3f, 0.3f, 1.3f));
+			if (holdingLantern)
+			{
+				lightPos = camera.Position;
+				lightPos = lightPos + camera.Front * 0.2f + camera.Right * 0.2f - camera.Up * 0.2f;
+			}
 
-		lightingShader.setMat4("model", model);
+			scene.setPosition(lantern, lightPos);
+		}
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		// recompute only the nodes that moved, and refit their bounds in the BVH
+		{
+			ProfileScope scope(profiler, sceneUpdateSection);
+			scene.update();
+			culler.update(scene);
+		}
 
-		// ============ FLOOR ==============
-		// set material properties
-		lightingShader.setVec3("material.ambient", 0.0f, 0.0f, 0.0f);
-		lightingShader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-		lightingShader.setFloat("material.shininess", 32.0f);
+		doorPosition = glm::vec3(scene.worldMatrix(doorHinge)[3]);
 
-		// Draw the floor
-		glBindVertexArray(cubeVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, marble);
+		// Recording: CPU work on the job pool, in two rounds. First the light
+		// clusters, the visible set and the shadow casters, which don't depend
+		// on each other; then the visible set is split between the workers.
+		// None of it touches GL, so the jobs only fill command buffers.
+		bool doorMoving = doorOpening || doorClosing;
+		bool redrawStaticShadows;
+		{
+			ProfileScope scope(profiler, recordSection);
+			commandReplay.resetStats();
 
-		/*glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, nothing);*/
+			if (doorMoving != doorWasMoving)
+				lanternShadow.invalidate();
+			doorWasMoving = doorMoving;
 
-		model = glm::mat4();
+			lanternShadow.setResolution(shadowResolution);
+			redrawStaticShadows = lanternShadow.update(lightPos);
 
-		glm::mat4 floorTransforms[] = {
-			glm::translate(model, glm::vec3(1.5f, -1.0f, 1.5f)),
-			glm::translate(model, glm::vec3(1.5f, -1.0f, -1.5f)),
-			glm::translate(model, glm::vec3(-1.5f, -1.0f, 1.5f)),
-			glm::translate(model, glm::vec3(-1.5f, -1.0f, -1.5f))
-		};
+			glm::mat4 viewProjection = projection * view;
+			const std::vector<int> *visible = NULL;
 
-		lightingShader.setVec3("material.specular", glm::vec3(0.7f,0.7f,0.7f));
-		lightingShader.setFloat("material.shininess", 100.0f);
+			jobs.run(3, [&](unsigned int job)
+			{
+				if (job == 0)
+				{
+					// sort the point lights into the clusters of this view
+					pointLights.cluster(projection, view, NEAR_PLANE, FAR_PLANE);
+				}
+				else if (job == 1)
+				{
+					portals.update(viewProjection, camera.Position);
+					visible = &culler.cull(viewProjection, &portals);
+				}
+				else
+				{
+					// the static cache only when it must be redrawn; the door joins it while at rest
+					shadowCommands[0].clear();
+					if (redrawStaticShadows)
+					{
+						shadowCommands[0].useProgram(stateKey(0, 0, 0), shadowShader.ID);
+						shadowCommands[0].setVec3(stateKey(0, 0, 1), shadowLightUniform.location, lightPos);
+						for (int face = 0; face < 6; face++)
+							shadowCommands[0].setMat4(stateKey(0, 0, 2 + face), shadowMatrixUniforms[face].location, lanternShadow.faceMatrices()[face]);
+
+						for (size_t c = 0; c < staticCasters.size(); c++)
+							recordNode(shadowCommands[0], lightPos, SHADOW_FAR, staticCasters[c]);
+						for (size_t c = 0; c < doorCasters.size() && !doorMoving; c++)
+							recordNode(shadowCommands[0], lightPos, SHADOW_FAR, doorCasters[c]);
+						shadowCommands[0].sort();
+					}
+
+					shadowCommands[1].clear();
+					shadowCommands[1].useProgram(stateKey(0, 0, 0), shadowShader.ID);
+					for (size_t c = 0; c < ghostCasters.size(); c++)
+						recordNode(shadowCommands[1], lightPos, SHADOW_FAR, ghostCasters[c]);
+					for (size_t c = 0; c < doorCasters.size() && doorMoving; c++)
+						recordNode(shadowCommands[1], lightPos, SHADOW_FAR, doorCasters[c]);
+					shadowCommands[1].sort();
+				}
+			});
+
+			// whatever of the ghost, floor, walls, painting, table, door and corridor is in
+			// view and not behind a closed door, sorted by state and then front to back
+			unsigned int chunk = ((unsigned int)visible->size() + sceneCommandCount - 1) / sceneCommandCount;
+
+			jobs.run(sceneCommandCount, [&](unsigned int job)
+			{
+				CommandBuffer &commands = sceneCommands[job];
+				commands.clear();
 
-		for (i = 0; i < 4; i++)
-		{
-			model = floorTransforms[i];
-			model = glm::scale(model, glm::vec3(3.0f, 1.0f, 3.0f));
-			lightingShader.setMat4("model", model);
+				// deferred shading only lays down the surfaces in this pass
+				if (job == 0)
+					commands.useProgram(stateKey(0, 0, 0), deferredShading ? gbufferShader.ID : lightingShader.ID);
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+				for (size_t v = job * chunk; v < visible->size() && v < (job + 1) * chunk; v++)
+					recordNode(commands, camera.Position, FAR_PLANE, (*visible)[v]);
+				commands.sort();
+			});
 		}
 
-		// Draw the ceiling
-		for (i = 0; i < 4; i++)
 		{
-			model = floorTransforms[i];
-			model = glm::translate(model, glm::vec3(0.0f, 4.0f, 0.0f));
-			model = glm::scale(model, glm::vec3(3.0f, 1.0f, 3.0f));
-			lightingShader.setMat4("model", model);
+			ProfileScope scope(profiler, lightsSection);
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			pointLights.upload();
+			pointLights.bind();
+			lightingShader.use();
+			lightingShader.setVec4(clusterParamsUniform, pointLights.shaderParams(width, height));
 		}
 
-		// Create walls
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, bricks);
-
-		model = glm::mat4();
-
-		glm::mat4 wallTransforms[] = {
-			glm::translate(model, glm::vec3(1.5f, 1.0f, -3.0f)),
-			glm::translate(model, glm::vec3(-1.5f, 1.0f, -3.0f)),
-			glm::translate(model, glm::vec3(1.5f, 1.0f, 3.0f)),
-			glm::translate(model, glm::vec3(-1.5f, 1.0f, 3.0f)),
-			glm::translate(model, glm::vec3(3.0f, 1.0f, -1.5f)),
-			glm::translate(model, glm::vec3(-3.0f, 1.0f, -1.5f)),
-			glm::translate(model, glm::vec3(3.0f, 1.0f, 1.5f)),
-			glm::translate(model, glm::vec3(-3.0f, 1.0f, 1.5f))		
-		};
-
-		lightingShader.setVec3("material.specular", glm::vec3(0.1f, 0.1f, 0.1f));
-		lightingShader.setFloat("material.shininess", 20.0f);
-
-		for (i = 0; i < 8; i++)
+		// lantern shadows: redraw the cached static casters only if the lantern moved
+		// or the door started or stopped swinging, then add the moving ones on top
 		{
-			model = wallTransforms[i];
-			
-			if (i >= 4)
-				model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			ProfileScope scope(profiler, shadowSection);
 
-			model = glm::scale(model, glm::vec3(3.0f, 3.0f, 0.01f));
+			if (redrawStaticShadows)
+			{
+				lanternShadow.beginStatic();
+				commandReplay.submit(shadowCommands[0]);
+			}
 
-			lightingShader.setMat4("model", model);
+			lanternShadow.beginDynamic();
+			commandReplay.submit(shadowCommands[1]);
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			lanternShadow.end(width, height);
+			lanternShadow.bind();
 		}
 
-		// Ghost clouds painting
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, painting);
-
-		model = glm::mat4();
-
-		model = glm::translate(model, glm::vec3(0.0f, 1.2f, -3.0f));
-		model = glm::scale(model, glm::vec3(3.0f, 1.65f, 0.02f));
-		model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-		lightingShader.setMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-		// Painting Frame
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, wood);
-
-		glm::vec3 frameTransforms[] = {
-			glm::vec3(0.0f, -0.825f, 0.0f),
-			glm::vec3(0.0f, 0.825f, 0.0f),
-			glm::vec3(1.55f, 0.0f, 0.0f),
-			glm::vec3(-1.55f, 0.0f, 0.0f)
-		};
-
-		for (i = 0; i < 4; i++)
+		// replay the scene, merging what each worker recorded
 		{
-			model = glm::mat4();
+			ProfileScope scope(profiler, sceneDrawSection);
 
-			model = glm::translate(model, frameTransforms[i]);
-			model = glm::translate(model, glm::vec3(0.0f, 1.2f, -3.0f));
-
-			if (i <= 1)
-				model = glm::scale(model, glm::vec3(3.2f, 0.1, 0.04f));
-			else
-				model = glm::scale(model, glm::vec3(0.1f, 1.65f, 0.04f));
+			if (deferredShading)
+			{
+				deferredRenderer.resize(width, height);
+				deferredRenderer.beginGeometry(clearColour);
+			}
 
-			lightingShader.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			commandReplay.submit(&sceneCommandPointers[0], sceneCommandCount);
 		}
 
-		// Render table
-		model = glm::translate(glm::mat4(), glm::vec3(0.0f, -0.15f, 0.0f));
-		model = glm::scale(model, glm::vec3(3.0f, 0.05f, 1.5f));
-		
-		lightingShader.setMat4("model", model);
-		lightingShader.setVec3("material.specular", glm::vec3(0.3f, 0.3f, 0.3f));
-		lightingShader.setFloat("material.shininess", 40.0f);
-
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		// light the G-buffer: ambient and the lantern over the whole screen, then a sphere per point light
+		if (deferredShading)
+		{
+			ProfileScope scope(profiler, deferredSection);
 
-		// Table legs
-		glm::vec3 legTransforms[] = {
-			glm::vec3(1.45f, -0.3f, 0.7f),
-			glm::vec3(1.45f, -0.3f, -0.7f),
-			glm::vec3(-1.45f, -0.3f, 0.7f),
-			glm::vec3(-1.45f, -0.3f, -0.7f)
-		};
+			glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+			deferredRenderer.beginLighting();
 
-		for (i = 0; i < 4; i++)
-		{
-			model = glm::translate(glm::mat4(), legTransforms[i]);
-			model = glm::scale(model, glm::vec3(0.05f, 0.35f, 0.05f));
-			lightingShader.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
+			ambientShader.use();
+			ambientShader.setMat4(ambientInverseUniform, inverseViewProjection);
+			deferredRenderer.drawAmbient();
 
-		// Render door
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, door);
-		
-		float doorAngle;
+			lightVolumeShader.use();
+			lightVolumeShader.setMat4(volumeInverseUniform, inverseViewProjection);
+			deferredRenderer.drawLightVolumes(pointLights.size());
 
-		if (doorOpening)
-		{
-			doorAngle = 1.5f * (currentFrame - animFrame);
-			if (doorAngle > glm::radians(120.0f))
-			{
-				doorOpening = false;
-				doorOpen = true;
-				doorAngle = glm::radians(120.0f);
-			}
-		}	
-		else if (doorClosing)
-		{
-			doorAngle = glm::radians(120.0f) - 1.5 * (currentFrame - animFrame);
-			if (doorAngle < 0.0f)
-			{
-				doorClosing = false;
-				doorOpen = false;
-				doorAngle = 0.0f;
-			}
+			// the lamp below is drawn forward on top, so depth comes along
+			deferredRenderer.finish();
 		}
-		else if (doorOpen)
-			doorAngle = glm::radians(120.0f);
-		else
-			doorAngle = 0.0f;
-
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(3.0f, 0.0f, 0.3f));
-		model = glm::rotate(model, doorAngle, glm::vec3(0.0f, 1.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, -0.3f));
-		model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		model = scale(model, glm::vec3(0.6f, 1.2f, 0.08f));
-
-		lightingShader.setMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-		// render corridor behind door
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, corridor);
-		
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(3.0f, 0.0f, 0.0f));
-		model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		model = scale(model, glm::vec3(0.6f, 1.2f, 0.02f));
 
-		lightingShader.setMat4("model", model);
-		lightingShader.setVec3("material.specular", glm::vec3(0.0f, 0.0f, 0.0f));
-		lightingShader.setFloat("material.shininess", 0.0f);
+		// render the lamp object
+		{
+			ProfileScope scope(profiler, lampSection);
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+			lampShader.use();
+			lampShader.setMat4(lampModelUniform, scene.worldMatrix(lantern));
 
-		// set lantern position
-		if (holdingLantern)
-		{
-			lightPos = camera.Position;
-			lightPos = lightPos + camera.Front * 0.2f + camera.Right * 0.2f - camera.Up * 0.2f;
+			glState().bindVertexArray(meshPool.VAO);
+			lampMesh.draw();
 		}
 
-		// render the lamp object
-		lampShader.use();
-		lampShader.setMat4("projection", projection);
-		lampShader.setMat4("view", view);
-		model = glm::mat4();
-		model = glm::translate(model, lightPos);
-		model = glm::scale(model, glm::vec3(0.2));
-		lampShader.setMat4("model", model);
-
-		glBindVertexArray(lightVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		// nothing after this reads this frame's part of the ring
+		frameStream.endFrame();
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		if (benchmark.enabled)
+			benchmark.endFrame();
 	}
 
+	if (benchmark.enabled)
+		benchmark.writeReport("Maps", profiler);
+
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
-	glDeleteVertexArrays(1, &cubeVAO);
-	glDeleteVertexArrays(1, &lightVAO);
-	glDeleteBuffers(1, &VBO);
+	glDeleteVertexArrays(1, &meshPool.VAO);
+	glDeleteBuffers(1, &meshPool.VBO);
+	glDeleteBuffers(1, &meshPool.IBO);
+	glDeleteBuffers(1, &frameUniforms.UBO);
+	glDeleteBuffers(1, &instanceRenderer.VBO);
+	glDeleteBuffers(1, &frameStream.ID);
+	frameStream.deleteFences();
+	glDeleteBuffers(3, pointLights.TBO);
+	glDeleteTextures(3, pointLights.textures);
+	glDeleteFramebuffers(2, deferredRenderer.FBO);
+	glDeleteTextures(4, deferredRenderer.textures);
+	glDeleteVertexArrays(1, &deferredRenderer.volumeVAO);
+	glDeleteVertexArrays(1, &deferredRenderer.emptyVAO);
+	glDeleteFramebuffers(4, lanternShadow.FBO);
+	glDeleteTextures(2, lanternShadow.textures);
+	glDeleteBuffers(2, textureLoader.PBO);
+	glDeleteFramebuffers(2, diffuseArray.FBO);
+	glDeleteTextures(1, &diffuseArray.ID);
+	profiler.deleteQueries();
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -622,168 +880,154 @@ int main()
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
 {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	input.dispatch(glfwGetTime());
+
+	if (input.pressed(INPUT_QUIT))
 		glfwSetWindowShouldClose(window, true);
 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		camera.ProcessKeyboard(FORWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		camera.ProcessKeyboard(BACKWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		camera.ProcessKeyboard(LEFT, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		camera.ProcessKeyboard(RIGHT, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		camera.ProcessKeyboard(UP, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		camera.ProcessKeyboard(DOWN, deltaTime);
-	
+	// move for exactly as long as each key was held since the last frame
+	camera.ProcessKeyboard(FORWARD, input.heldFor(INPUT_FORWARD));
+	camera.ProcessKeyboard(BACKWARD, input.heldFor(INPUT_BACKWARD));
+	camera.ProcessKeyboard(LEFT, input.heldFor(INPUT_TURN_LEFT));
+	camera.ProcessKeyboard(RIGHT, input.heldFor(INPUT_TURN_RIGHT));
+	camera.ProcessKeyboard(UP, input.heldFor(INPUT_LOOK_UP));
+	camera.ProcessKeyboard(DOWN, input.heldFor(INPUT_LOOK_DOWN));
+
 	// Jump with the space key
-	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+	if (input.pressed(INPUT_JUMP))
 	{
 		jumping = true;
-		jumpFrame = glfwGetTime();
+		jumpPhase = 0.0f;
 	}
 
 	// Change the perspective with the p key
-	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !pheld)
-	{
+	if (input.pressed(INPUT_PROJECTION) % 2)
 		ortho = !ortho;
-		pheld = true;
-	}
-	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE && pheld)
-	{
-		pheld = false;
-	}
-	
+
 	// Change light radius with k and l
-	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !lheld)
-	{
-		lightradius++;
-		lheld = true;
-	}
-	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE && lheld)
-	{
-		lheld = false;
-	}
-	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && !kheld)
-	{
-		if (lightradius >= 1.0)
-			lightradius--;
-		kheld = true;
-	}
-	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE && kheld)
-	{
-		kheld = false;
-	}
+	lightradius += input.pressed(INPUT_RADIUS_UP);
+	for (unsigned int n = input.pressed(INPUT_RADIUS_DOWN); n > 0 && lightradius >= 1.0; n--)
+		lightradius--;
 
 	// Toggle lighting mode with o
-	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !oheld)
-	{
+	if (input.pressed(INPUT_FULL_LIGHT) % 2)
 		fulllight = !fulllight;
-		oheld = true;
-	}
-	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE && oheld)
-	{
-		oheld = false;
-	}
+
+	// Halve and double the shadow resolution with 9 and 0
+	for (unsigned int n = input.pressed(INPUT_SHADOW_DOWN); n > 0 && shadowResolution > 128; n--)
+		shadowResolution /= 2;
+	for (unsigned int n = input.pressed(INPUT_SHADOW_UP); n > 0 && shadowResolution < 2048; n--)
+		shadowResolution *= 2;
 
 	// Zoom in and out with 3 and 1
-	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS && !zoomoutheld)
-	{
+	for (unsigned int n = input.pressed(INPUT_ZOOM_OUT); n > 0; n--)
 		camera.decreaseZoom();
-		zoomoutheld = true;
-	}
-	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_RELEASE && zoomoutheld)
-	{
-		zoomoutheld = false;
-	}
-	
-	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS && !zoominheld)
-	{
+	for (unsigned int n = input.pressed(INPUT_ZOOM_IN); n > 0; n--)
 		camera.increaseZoom();
-		zoominheld = true;
-	}
-	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_RELEASE && zoominheld)
+
+	// Pick up the lantern with f
+	if (input.pressed(INPUT_LANTERN) % 2)
+		toggleLantern();
+
+	// Print the profiler report with t
+	if (input.pressed(INPUT_PROFILE))
+		printProfile = true;
+
+	// Switch between forward and deferred shading with g
+	if (input.pressed(INPUT_DEFERRED) % 2)
+		deferredShading = !deferredShading;
+
+	// Turn vsync on or off with v; the simulation keeps its pace either way
+	if (input.pressed(INPUT_VSYNC) % 2)
 	{
-		zoominheld = false;
+		vsync = !vsync;
+		glfwSwapInterval(vsync ? 1 : 0);
 	}
 
-	// Pick up the lantern with f
-	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !fheld)
+	// Open the door with r
+	if (input.pressed(INPUT_DOOR))
+		toggleDoor();
+}
+
+// One simulation tick of dt seconds: the jump, the ghost and the door
+void simulate(float dt)
+{
+	jumpHeight.store();
+	ghostAngle.store();
+	ghostBob.store();
+	doorAngle.store();
+
+	// the camera dips and rises over half a sine wave
+	if (jumping)
 	{
-		if (glm::length(lightPos - camera.Position) < 2.0f)
+		jumpPhase += 3.0f * dt;
+		if (jumpPhase >= M_PI)
 		{
-			holdingLantern = !holdingLantern;
-			if (!holdingLantern)
-				lightPos = glm::vec3(lightPos.x, -0.4f, lightPos.z);
+			jumpPhase = 0.0f;
+			jumping = false;
 		}
-		fheld = true;
+		jumpHeight.current = -glm::sin(jumpPhase);
 	}
-	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE && fheld)
+
+	// the ghost circles once every 2 pi seconds, bobbing as it goes
+	ghostAngle.current -= dt;
+	if (ghostAngle.current < -2.0f * (float)M_PI)
+		ghostAngle.shift(2.0f * (float)M_PI);
+	ghostBob.current = 0.2f * glm::sin((float)simClock.time() * 4);
+
+	if (doorOpening)
 	{
-		fheld = false;
+		doorAngle.current += 1.5f * dt;
+		if (doorAngle.current > glm::radians(120.0f))
+		{
+			doorOpening = false;
+			doorOpen = true;
+			doorAngle.current = glm::radians(120.0f);
+		}
 	}
-
-	// Open the door with r
-	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !doorOpening && !doorClosing)
+	else if (doorClosing)
 	{
-		if (glm::length(camera.Position - glm::vec3(3.0f, 0.0f, 0.0f)) < 2.0f)
+		doorAngle.current -= 1.5f * dt;
+		if (doorAngle.current < 0.0f)
 		{
-			animFrame = glfwGetTime();
-		
-			if (doorOpen)
-				doorClosing = true;
-			else
-				doorOpening = true;
+			doorClosing = false;
+			doorOpen = false;
+			doorAngle.current = 0.0f;
 		}
 	}
 }
 
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
-// ---------------------------------------------------------------------------------------------
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+// Picks up or puts down the lantern when the camera is close enough
+void toggleLantern()
 {
-	// make sure the viewport matches the new window dimensions; note that width and 
-	// height will be significantly larger than specified on retina displays.
-	glViewport(0, 0, width, height);
+	if (glm::length(lightPos - camera.Position) < 2.0f)
+	{
+		holdingLantern = !holdingLantern;
+		if (!holdingLantern)
+			lightPos = glm::vec3(lightPos.x, -0.4f, lightPos.z);
+	}
 }
 
-// Function for loading a 2D texture
-unsigned int loadTexture(char const *path)
+// Starts opening or closing the door when the camera is close enough and it isn't already moving
+void toggleDoor()
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	if (doorOpening || doorClosing)
+		return;
 
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-
-	if (data)
+	if (glm::length(camera.Position - doorPosition) < 2.0f)
 	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+		if (doorOpen)
+			doorClosing = true;
+		else
+			doorOpening = true;
 	}
+}
 
-	return textureID;
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	// make sure the viewport matches the new window dimensions; note that width and 
+	// height will be significantly larger than specified on retina displays.
+	glViewport(0, 0, width, height);
 }
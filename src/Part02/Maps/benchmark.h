@@ -0,0 +1,280 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+// A point on a scripted camera path
+struct CameraKey
+{
+	float time;
+	glm::vec3 position;
+	float yaw;
+	float pitch;
+};
+
+// A scripted action, identified by a program-defined number
+struct BenchmarkAction
+{
+	float time;
+	int action;
+};
+
+// Headless benchmark mode, enabled with
+//
+//	--benchmark [frames] [--timestep seconds] [--warmup frames] [--output file.json] [--context native|egl|osmesa]
+//
+// The program runs in a hidden window without vsync, replays a scripted
+// camera path and actions instead of reading the keyboard, and advances the
+// GLFW clock by a fixed timestep per frame so every run animates the same
+// way. Each frame ends with glFinish, so frame times include the GPU's work.
+// After the last frame it writes frame-time statistics (and the profiler's
+// sections) as JSON.
+class Benchmark
+{
+public:
+	bool enabled;
+	unsigned int frameCount;
+	unsigned int warmupFrames;	// rendered but left out of the statistics
+	float timestep;
+	std::string outputPath;		// stdout when empty
+	std::string contextAPI;
+
+	Benchmark() : enabled(false), frameCount(600), warmupFrames(10), timestep(1.0f / 60.0f), contextAPI("native"), frame(0) {}
+
+	// Reads the benchmark options; returns false on a malformed command line
+	bool parse(int argc, char **argv)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+
+			if (arg == "--benchmark")
+			{
+				enabled = true;
+				if (hasValue)
+					frameCount = atoi(argv[++i]);
+			}
+			else if (arg == "--timestep" && hasValue)
+				timestep = (float)atof(argv[++i]);
+			else if (arg == "--warmup" && hasValue)
+				warmupFrames = atoi(argv[++i]);
+			else if (arg == "--output" && hasValue)
+				outputPath = argv[++i];
+			else if (arg == "--context" && hasValue)
+				contextAPI = argv[++i];
+			else
+			{
+				std::cout << "Unknown or incomplete option: " << arg << std::endl;
+				return false;
+			}
+		}
+
+		return frameCount > 0 && timestep > 0.0f;
+	}
+
+	// Window hints for a hidden window, set between glfwInit and glfwCreateWindow
+	void windowHints() const
+	{
+		if (!enabled)
+			return;
+
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+		if (contextAPI == "egl")
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+		else if (contextAPI == "osmesa")
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+	}
+
+	void addCameraKey(float time, const glm::vec3 &position, float yaw, float pitch)
+	{
+		CameraKey key = { time, position, yaw, pitch };
+		path.push_back(key);
+	}
+
+	void addAction(float time, int action)
+	{
+		BenchmarkAction a = { time, action };
+		actions.push_back(a);
+	}
+
+	// Sets the clock for the next frame; returns false once every frame has been rendered
+	bool beginFrame()
+	{
+		if (frame >= frameCount)
+			return false;
+
+		glfwSetTime(time());
+		frameStart = Clock::now();
+		return true;
+	}
+
+	// Waits for the GPU and records the frame's duration
+	void endFrame()
+	{
+		glFinish();
+
+		if (frame >= warmupFrames)
+			frameTimes.push_back(std::chrono::duration<float, std::milli>(Clock::now() - frameStart).count());
+
+		frame++;
+	}
+
+	// Scripted time of the current frame
+	float time() const
+	{
+		return frame * timestep;
+	}
+
+	// Camera placement at the current frame, interpolated between keys
+	void camera(glm::vec3 &position, float &yaw, float &pitch) const
+	{
+		float t = time();
+		size_t next = 0;
+		while (next < path.size() && path[next].time <= t)
+			next++;
+
+		if (next == 0 || next == path.size())
+		{
+			const CameraKey &key = path[next == 0 ? 0 : path.size() - 1];
+			position = key.position;
+			yaw = key.yaw;
+			pitch = key.pitch;
+			return;
+		}
+
+		const CameraKey &a = path[next - 1];
+		const CameraKey &b = path[next];
+		float f = (t - a.time) / (b.time - a.time);
+
+		position = glm::mix(a.position, b.position, f);
+		yaw = a.yaw + (b.yaw - a.yaw) * f;
+		pitch = a.pitch + (b.pitch - a.pitch) * f;
+	}
+
+	// Camera direction for a yaw and pitch, the same way Camera computes it
+	static glm::vec3 front(float yaw, float pitch)
+	{
+		glm::vec3 front;
+		front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+		front.y = sin(glm::radians(pitch));
+		front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+		return glm::normalize(front);
+	}
+
+	// Actions scheduled during the current frame
+	std::vector<int> dueActions() const
+	{
+		std::vector<int> due;
+		// the same expression as the next frame's time(), so no action falls between frames
+		float start = time(), end = (frame + 1) * timestep;
+
+		for (size_t i = 0; i < actions.size(); i++)
+		{
+			if (actions[i].time >= start && actions[i].time < end)
+				due.push_back(actions[i].action);
+		}
+
+		return due;
+	}
+
+	// Writes the results as JSON to outputPath, or stdout
+	bool writeReport(const std::string &program, const Profiler &profiler) const
+	{
+		std::ofstream file;
+		if (!outputPath.empty())
+		{
+			file.open(outputPath.c_str(), std::ios::trunc);
+			if (!file)
+			{
+				std::cout << "Failed to open " << outputPath << " for writing" << std::endl;
+				return false;
+			}
+		}
+		std::ostream &out = outputPath.empty() ? std::cout : file;
+
+		std::vector<float> sorted(frameTimes);
+		std::sort(sorted.begin(), sorted.end());
+
+		float total = 0.0f;
+		for (size_t i = 0; i < sorted.size(); i++)
+			total += sorted[i];
+
+		out << std::fixed << std::setprecision(4);
+		out << "{" << std::endl;
+		out << "\t\"program\": " << jsonString(program.c_str()) << "," << std::endl;
+		out << "\t\"renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << "," << std::endl;
+		out << "\t\"frames\": " << sorted.size() << "," << std::endl;
+		out << "\t\"warmup_frames\": " << warmupFrames << "," << std::endl;
+		out << "\t\"timestep\": " << timestep << "," << std::endl;
+
+		if (!sorted.empty())
+		{
+			out << "\t\"fps\": " << sorted.size() * 1000.0f / total << "," << std::endl;
+			out << "\t\"frame_ms\": { ";
+			out << "\"min\": " << sorted.front() << ", ";
+			out << "\"avg\": " << total / sorted.size() << ", ";
+			out << "\"p50\": " << percentile(sorted, 50) << ", ";
+			out << "\"p95\": " << percentile(sorted, 95) << ", ";
+			out << "\"p99\": " << percentile(sorted, 99) << ", ";
+			out << "\"max\": " << sorted.back() << " }," << std::endl;
+		}
+
+		out << "\t\"sections\": ";
+		profiler.writeJSON(out, "\t");
+		out << std::endl << "}" << std::endl;
+
+		return true;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	unsigned int frame;
+	Clock::time_point frameStart;
+	std::vector<float> frameTimes;
+	std::vector<CameraKey> path;
+	std::vector<BenchmarkAction> actions;
+
+	// Quotes a string for JSON; driver strings can hold anything, or be NULL without a context
+	static std::string jsonString(const char *text)
+	{
+		std::string quoted = "\"";
+		for (const char *c = text ? text : ""; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				quoted += '\\';
+
+			if ((unsigned char)*c < 0x20)
+				quoted += ' ';
+			else
+				quoted += *c;
+		}
+
+		return quoted + "\"";
+	}
+
+	static float percentile(const std::vector<float> &sorted, unsigned int p)
+	{
+		return sorted[(sorted.size() - 1) * p / 100];
+	}
+};
+
+#endif
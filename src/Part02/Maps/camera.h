@@ -98,6 +98,15 @@ public:
 		updateCameraVectors();
 	}
 
+	// Places the camera directly, e.g. when replaying a scripted path
+	void SetView(glm::vec3 position, float yaw, float pitch)
+	{
+		Position = position;
+		Yaw = yaw;
+		Pitch = pitch;
+		updateCameraVectors();
+	}
+
 	void increaseZoom()
 	{
 		Zoom -= 11.0f;
@@ -0,0 +1,378 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "frustum.h"
+#include "gl_state.h"
+
+// Clusters the view frustum is split into: tiles across the screen, and
+// depth slices spaced exponentially so near clusters stay small
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// Texture units the light data is bound to; unit 0 holds the diffuse maps
+const unsigned int POINT_LIGHTS_UNIT = 1;
+const unsigned int LIGHT_CLUSTERS_UNIT = 2;
+const unsigned int LIGHT_INDICES_UNIT = 3;
+
+// A light stops counting where it adds less than this to a channel
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// A point light, attenuated like the lantern (falloff / distance^2) when
+// falloff is set, otherwise by 1 / (constant + linear * d + quadratic * d^2)
+struct PointLight
+{
+	glm::vec3 position;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float falloff;
+	float constant, linear, quadratic;
+};
+
+// Distance beyond which a light is too dim to see
+inline float lightRange(const PointLight &light)
+{
+	float brightest = glm::max(glm::max(glm::max(light.diffuse.x, light.diffuse.y), glm::max(light.diffuse.z, light.specular.x)), glm::max(light.specular.y, light.specular.z));
+	float limit = brightest / LIGHT_CUTOFF;
+
+	if (light.falloff > 0.0f)
+		return sqrtf(light.falloff * limit);
+
+	// solve quadratic * d^2 + linear * d + constant = limit
+	if (light.quadratic > 0.0f)
+		return (-light.linear + sqrtf(light.linear * light.linear - 4.0f * light.quadratic * (light.constant - limit))) / (2.0f * light.quadratic);
+	if (light.linear > 0.0f)
+		return (limit - light.constant) / light.linear;
+
+	return 1e30f;
+}
+
+// Clustered forward lighting. Every frame each light is assigned, on the
+// CPU, to the view-space clusters its sphere of influence touches; the
+// fragment shader finds its cluster from gl_FragCoord and view depth and
+// only loops over that cluster's lights. Lights, cluster ranges and the
+// light index list live in texture buffers, which GL 3.3 can sample from
+// any shader:
+//
+//	pointLights	RGBA32F, 4 texels per light: position + falloff,
+//			diffuse + constant, specular + linear, quadratic + range
+//	lightClusters	RG32UI, first index and count per cluster
+//	lightIndices	R16UI, light numbers grouped by cluster
+class ClusteredLights
+{
+public:
+	// Texture buffer objects and the buffer textures viewing them: lights, clusters, indices
+	unsigned int TBO[3];
+	unsigned int textures[3];
+
+	struct Stats
+	{
+		unsigned int lights;		// lights in range of the view
+		unsigned int assignments;	// light-cluster pairs, i.e. length of the index list
+		unsigned int maxPerCluster;
+	};
+
+	Stats stats;
+
+	ClusteredLights() : viewNear(0.0f), viewFar(0.0f)
+	{
+		stats.lights = stats.assignments = stats.maxPerCluster = 0;
+
+		const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+
+		glGenBuffers(3, TBO);
+		glGenTextures(3, textures);
+
+		for (int i = 0; i < 3; i++)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, TBO[i]);
+			glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+
+			glState().bindTexture(GL_TEXTURE_BUFFER, textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], TBO[i]);
+		}
+
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		glState().bindTexture(GL_TEXTURE_BUFFER, 0);
+
+		clusterRanges.resize(CLUSTER_COUNT * 2);
+		clusterCounts.resize(CLUSTER_COUNT);
+	}
+
+	ClusteredLights(const ClusteredLights&) = delete;
+	ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+	// Adds a light and returns its number, or -1 past the 65536 the index list can address
+	int add(const PointLight &light)
+	{
+		if (lights.size() >= 65536)
+		{
+			std::cout << "ERROR::CLUSTERED_LIGHTS::TOO_MANY_LIGHTS" << std::endl;
+			return -1;
+		}
+
+		lights.push_back(light);
+		return (int)lights.size() - 1;
+	}
+
+	PointLight &light(int i)
+	{
+		return lights[i];
+	}
+
+	unsigned int size() const
+	{
+		return (unsigned int)lights.size();
+	}
+
+	// Assigns the lights to clusters for this view and uploads the lists;
+	// nearPlane and farPlane must be the ones projection was built with
+	void update(const glm::mat4 &projection, const glm::mat4 &view, float nearPlane, float farPlane)
+	{
+		cluster(projection, view, nearPlane, farPlane);
+		upload();
+	}
+
+	// The CPU half of update(), which touches no GL and may run on any thread
+	void cluster(const glm::mat4 &projection, const glm::mat4 &view, float nearPlane, float farPlane)
+	{
+		if (projection != clusterProjection || nearPlane != viewNear || farPlane != viewFar)
+			buildClusters(projection, nearPlane, farPlane);
+
+		stats.lights = stats.assignments = stats.maxPerCluster = 0;
+		std::fill(clusterCounts.begin(), clusterCounts.end(), 0u);
+		pairs.clear();
+		lightData.clear();
+
+		for (size_t i = 0; i < lights.size(); i++)
+		{
+			const PointLight &light = lights[i];
+			float range = lightRange(light);
+
+			glm::vec4 data[4] = {
+				glm::vec4(light.position, light.falloff),
+				glm::vec4(light.diffuse, light.constant),
+				glm::vec4(light.specular, light.linear),
+				glm::vec4(light.quadratic, range, 0.0f, 0.0f)
+			};
+			lightData.insert(lightData.end(), data, data + 4);
+
+			if (assign((unsigned int)i, glm::vec3(view * glm::vec4(light.position, 1.0f)), range))
+				stats.lights++;
+		}
+
+		// counting sort of the pairs by cluster; lights stay in order within a cluster
+		unsigned int offset = 0;
+		for (int c = 0; c < CLUSTER_COUNT; c++)
+		{
+			clusterRanges[c * 2] = offset;
+			clusterRanges[c * 2 + 1] = clusterCounts[c];
+			offset += clusterCounts[c];
+			stats.maxPerCluster = std::max(stats.maxPerCluster, clusterCounts[c]);
+		}
+
+		indices.resize(std::max(offset, 1u));
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			unsigned int &next = clusterRanges[pairs[i].cluster * 2];
+			indices[next++] = pairs[i].light;
+		}
+
+		// the fill loop advanced every offset by its count; step them back
+		for (int c = 0; c < CLUSTER_COUNT; c++)
+			clusterRanges[c * 2] -= clusterRanges[c * 2 + 1];
+
+		stats.assignments = offset;
+
+		if (lightData.empty())
+			lightData.push_back(glm::vec4(0.0f));
+	}
+
+	// The GL half of update(): uploads the lists cluster() built
+	void upload()
+	{
+		if (lightData.empty())
+			return;
+
+		// fresh storage every frame, so the driver never waits on the last frame's lists
+		uploadBuffer(0, &lightData[0], lightData.size() * sizeof(glm::vec4));
+		uploadBuffer(1, &clusterRanges[0], clusterRanges.size() * sizeof(unsigned int));
+		uploadBuffer(2, &indices[0], indices.size() * sizeof(uint16_t));
+	}
+
+	// Values the shader's clusterParams uniform needs for a framebuffer of the given size:
+	// tiles per pixel in x and y, then the scale and bias turning log(depth) into a slice
+	glm::vec4 shaderParams(int width, int height) const
+	{
+		float logRatio = logf(viewFar / viewNear);
+		return glm::vec4((float)CLUSTER_X / width, (float)CLUSTER_Y / height, CLUSTER_Z / logRatio, -CLUSTER_Z * logf(viewNear) / logRatio);
+	}
+
+	void bind() const
+	{
+		glState().bindTexture(POINT_LIGHTS_UNIT, GL_TEXTURE_BUFFER, textures[0]);
+		glState().bindTexture(LIGHT_CLUSTERS_UNIT, GL_TEXTURE_BUFFER, textures[1]);
+		glState().bindTexture(LIGHT_INDICES_UNIT, GL_TEXTURE_BUFFER, textures[2]);
+	}
+
+private:
+	struct Pair
+	{
+		unsigned int cluster;
+		unsigned int light;
+	};
+
+	std::vector<PointLight> lights;
+	std::vector<AABB> clusterBounds;	// view space, by cluster index
+	glm::mat4 clusterProjection;
+	float viewNear, viewFar;
+
+	// per-frame scratch, kept to avoid reallocating
+	std::vector<glm::vec4> lightData;
+	std::vector<unsigned int> clusterRanges;
+	std::vector<unsigned int> clusterCounts;
+	std::vector<Pair> pairs;
+	std::vector<uint16_t> indices;
+
+	static int clusterIndex(int x, int y, int z)
+	{
+		return (z * CLUSTER_Y + y) * CLUSTER_X + x;
+	}
+
+	// Depth (distance along -z in view space) where a slice starts
+	float sliceDepth(int slice) const
+	{
+		return viewNear * powf(viewFar / viewNear, (float)slice / CLUSTER_Z);
+	}
+
+	int depthSlice(float depth) const
+	{
+		int slice = (int)floorf(logf(depth / viewNear) / logf(viewFar / viewNear) * CLUSTER_Z);
+		return glm::clamp(slice, 0, CLUSTER_Z - 1);
+	}
+
+	bool perspective() const
+	{
+		return clusterProjection[3][3] == 0.0f;
+	}
+
+	// View-space point at a depth that projects to the given NDC x and y
+	glm::vec3 unproject(float ndcX, float ndcY, float depth) const
+	{
+		const glm::mat4 &p = clusterProjection;
+		float w = perspective() ? depth : 1.0f;
+		return glm::vec3((ndcX * w + p[2][0] * depth - p[3][0]) / p[0][0], (ndcY * w + p[2][1] * depth - p[3][1]) / p[1][1], -depth);
+	}
+
+	// NDC x and y of a view-space point
+	glm::vec2 project(const glm::vec3 &point) const
+	{
+		glm::vec4 clip = clusterProjection * glm::vec4(point, 1.0f);
+		return glm::vec2(clip) / clip.w;
+	}
+
+	void buildClusters(const glm::mat4 &projection, float nearPlane, float farPlane)
+	{
+		clusterProjection = projection;
+		viewNear = nearPlane;
+		viewFar = farPlane;
+		clusterBounds.resize(CLUSTER_COUNT);
+
+		for (int z = 0; z < CLUSTER_Z; z++)
+		{
+			float depths[2] = { sliceDepth(z), sliceDepth(z + 1) };
+
+			for (int y = 0; y < CLUSTER_Y; y++)
+			{
+				for (int x = 0; x < CLUSTER_X; x++)
+				{
+					AABB bounds;
+
+					for (int corner = 0; corner < 8; corner++)
+					{
+						float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / CLUSTER_X;
+						float ndcY = -1.0f + 2.0f * (y + ((corner >> 1) & 1)) / CLUSTER_Y;
+						glm::vec3 p = unproject(ndcX, ndcY, depths[corner >> 2]);
+						bounds.expand(AABB(p, p));
+					}
+
+					clusterBounds[clusterIndex(x, y, z)] = bounds;
+				}
+			}
+		}
+	}
+
+	// Records the clusters a light's sphere touches; false if it touches none
+	bool assign(unsigned int light, const glm::vec3 &centre, float radius)
+	{
+		float nearest = glm::max(-centre.z - radius, viewNear);
+		float furthest = glm::min(-centre.z + radius, viewFar);
+
+		if (nearest > furthest)
+			return false;
+
+		// screen rectangle of the sphere's view-space box, cut to the slices it spans:
+		// NDC is monotonic in x and 1 / depth, so the corners bound it
+		glm::vec2 ndcMin(1e30f), ndcMax(-1e30f);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 p(centre.x + ((corner & 1) ? radius : -radius), centre.y + ((corner & 2) ? radius : -radius), (corner & 4) ? -furthest : -nearest);
+			glm::vec2 ndc = project(p);
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+
+		int x0 = glm::max((int)floorf((ndcMin.x + 1.0f) * 0.5f * CLUSTER_X), 0);
+		int x1 = glm::min((int)floorf((ndcMax.x + 1.0f) * 0.5f * CLUSTER_X), CLUSTER_X - 1);
+		int y0 = glm::max((int)floorf((ndcMin.y + 1.0f) * 0.5f * CLUSTER_Y), 0);
+		int y1 = glm::min((int)floorf((ndcMax.y + 1.0f) * 0.5f * CLUSTER_Y), CLUSTER_Y - 1);
+		int z0 = depthSlice(nearest), z1 = depthSlice(furthest);
+
+		bool touched = false;
+
+		for (int z = z0; z <= z1; z++)
+		{
+			for (int y = y0; y <= y1; y++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					int c = clusterIndex(x, y, z);
+					const AABB &bounds = clusterBounds[c];
+
+					// the rectangle is loose near the slice edges; test the sphere against the cluster itself
+					glm::vec3 closest = glm::clamp(centre, bounds.min, bounds.max);
+					glm::vec3 d = closest - centre;
+					if (glm::dot(d, d) > radius * radius)
+						continue;
+
+					Pair pair = { (unsigned int)c, light };
+					pairs.push_back(pair);
+					clusterCounts[c]++;
+					touched = true;
+				}
+			}
+		}
+
+		return touched;
+	}
+
+	void uploadBuffer(int buffer, const void *data, size_t size)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, TBO[buffer]);
+		glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+};
+
+#endif
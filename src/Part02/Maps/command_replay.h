@@ -0,0 +1,123 @@
+#ifndef COMMAND_REPLAY_H
+#define COMMAND_REPLAY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <vector>
+
+#include "gl_state.h"
+#include "instancing.h"
+#include "mesh_library.h"
+#include "render_commands.h"
+
+// OpenGL backend for CommandBuffer: runs on the thread owning the context
+// and turns commands into GL calls. Program, uniform and texture handles are
+// GL names and locations; mesh handles are indices into the meshes added
+// here. Runs of draws between other commands go through the
+// InstanceRenderer, so draws of the same mesh and texture that end up next
+// to each other become one instanced call.
+class CommandReplay
+{
+public:
+	struct Stats
+	{
+		unsigned int commands;	// commands replayed since the last resetStats()
+		unsigned int draws;	// of which draws
+	};
+
+	Stats stats;
+
+	CommandReplay(InstanceRenderer &instances) : instances(instances)
+	{
+		resetStats();
+	}
+
+	CommandReplay(const CommandReplay&) = delete;
+	CommandReplay& operator=(const CommandReplay&) = delete;
+
+	// Makes a mesh drawable by the handle returned
+	unsigned int addMesh(const Mesh &mesh)
+	{
+		meshes.push_back(mesh);
+		return (unsigned int)meshes.size() - 1;
+	}
+
+	void resetStats()
+	{
+		stats.commands = stats.draws = 0;
+	}
+
+	// Replays one sorted buffer
+	void submit(const CommandBuffer &buffer)
+	{
+		const CommandBuffer *buffers[1] = { &buffer };
+		submit(buffers, 1);
+	}
+
+	// Replays several sorted buffers, merged so their commands run in key order;
+	// on equal keys the earlier buffer goes first
+	void submit(const CommandBuffer *const *buffers, unsigned int count)
+	{
+		heads.assign(count, 0);
+
+		while (true)
+		{
+			int best = -1;
+			for (unsigned int b = 0; b < count; b++)
+			{
+				if (heads[b] < buffers[b]->commands().size() &&
+					(best < 0 || buffers[b]->commands()[heads[b]].key < buffers[best]->commands()[heads[best]].key))
+					best = (int)b;
+			}
+
+			if (best < 0)
+				break;
+
+			execute(*buffers[best], buffers[best]->commands()[heads[best]++]);
+		}
+
+		instances.flush();
+	}
+
+private:
+	InstanceRenderer &instances;
+	std::vector<Mesh> meshes;
+	std::vector<size_t> heads;	// next command of each buffer being merged
+
+	void execute(const CommandBuffer &buffer, const RenderCommand &command)
+	{
+		stats.commands++;
+
+		if (command.type == RENDER_DRAW)
+		{
+			const RenderDraw &d = buffer.drawData(command.data);
+			InstanceIndices indices = { d.material, d.layer };
+			instances.add(meshes[command.handle], command.texture, d.model, d.normal, indices);
+			stats.draws++;
+			return;
+		}
+
+		// state changes apply to the draws after them only
+		instances.flush();
+
+		switch (command.type)
+		{
+		case RENDER_USE_PROGRAM:
+			glState().useProgram(command.handle);
+			break;
+		case RENDER_SET_MAT4:
+			glUniformMatrix4fv((GLint)command.handle, 1, GL_FALSE, glm::value_ptr(buffer.mat4(command.data)));
+			break;
+		case RENDER_SET_VEC3:
+			glUniform3fv((GLint)command.handle, 1, glm::value_ptr(buffer.vec4(command.data)));
+			break;
+		case RENDER_SET_VEC4:
+			glUniform4fv((GLint)command.handle, 1, glm::value_ptr(buffer.vec4(command.data)));
+			break;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "frustum.h"
+#include "portals.h"
+#include "scene_graph.h"
+
+// Bounding volume hierarchy over items identified by an int. Built top-down
+// by splitting at the median of the longest axis; every node covers a
+// contiguous range of the item order, so a node entirely inside the frustum
+// accepts its whole range without testing its children. Moving items only
+// need a refit, which is cheap, until the tree has loosened enough to be
+// worth rebuilding.
+class BVH
+{
+public:
+	BVH() : builtArea(0.0f), built(false), stale(false) {}
+
+	// Adds an item and returns its slot, used to update its bounds later
+	int insert(int id, const AABB &bounds)
+	{
+		ids.push_back(id);
+		itemBounds.push_back(bounds);
+		built = false;
+		return (int)ids.size() - 1;
+	}
+
+	void setBounds(int slot, const AABB &bounds)
+	{
+		itemBounds[slot] = bounds;
+		stale = true;
+	}
+
+	// Builds the tree if items were added, otherwise refits it if bounds
+	// changed; returns true when the tree was rebuilt
+	bool update()
+	{
+		if (built && stale)
+		{
+			refit();
+
+			// refitting only grows boxes; once the root is much looser than when
+			// it was built, the split choices no longer fit the scene
+			if (nodes[0].bounds.surfaceArea() > 2.0f * builtArea)
+				built = false;
+		}
+
+		if (built)
+			return false;
+
+		build();
+		return true;
+	}
+
+	// Appends the IDs of the items that intersect the frustum; returns the number of nodes tested
+	unsigned int cull(const Frustum &frustum, std::vector<int> &visible) const
+	{
+		unsigned int tests = 0;
+
+		if (nodes.empty())
+			return tests;
+
+		// median splits keep the tree about log2(items) deep, far within the stack
+		int stack[64];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0)
+		{
+			const Node &node = nodes[stack[--top]];
+
+			tests++;
+			FrustumTest result = frustum.test(node.bounds);
+
+			if (result == FRUSTUM_OUTSIDE)
+				continue;
+
+			if (result == FRUSTUM_INSIDE || node.left < 0)
+			{
+				for (int i = node.first; i < node.first + node.count; i++)
+				{
+					// leaves hold so few items that testing each one is worth it
+					if (result == FRUSTUM_INSIDE || frustum.test(itemBounds[order[i]]) != FRUSTUM_OUTSIDE)
+						visible.push_back(ids[order[i]]);
+				}
+				continue;
+			}
+
+			stack[top++] = node.left;
+			stack[top++] = node.left + 1;
+		}
+
+		return tests;
+	}
+
+	unsigned int size() const
+	{
+		return (unsigned int)ids.size();
+	}
+
+	const AABB &bounds(int slot) const
+	{
+		return itemBounds[slot];
+	}
+
+private:
+	static const int LEAF_SIZE = 2;
+
+	struct Node
+	{
+		AABB bounds;
+		int left;		// children are left and left + 1; -1 for a leaf
+		int first, count;	// range of order[] below this node
+	};
+
+	std::vector<int> ids;
+	std::vector<AABB> itemBounds;
+	std::vector<int> order;		// item slots, grouped by node
+	std::vector<Node> nodes;	// children always come after their parent
+	float builtArea;	// root surface area right after the last build
+	bool built;
+	bool stale;		// bounds changed since the last build or refit
+
+	void build()
+	{
+		nodes.clear();
+		order.resize(ids.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = (int)i;
+
+		if (!ids.empty())
+		{
+			Node root = { AABB(), -1, 0, (int)ids.size() };
+			nodes.push_back(root);
+			split(0);
+			builtArea = nodes[0].bounds.surfaceArea();
+		}
+
+		built = true;
+		stale = false;
+	}
+
+	void split(int index)
+	{
+		int first = nodes[index].first, count = nodes[index].count;
+
+		AABB bounds, centres;
+		for (int i = first; i < first + count; i++)
+		{
+			bounds.expand(itemBounds[order[i]]);
+			glm::vec3 c = itemBounds[order[i]].centre();
+			centres.expand(AABB(c, c));
+		}
+		nodes[index].bounds = bounds;
+
+		if (count <= LEAF_SIZE)
+			return;
+
+		glm::vec3 extent = centres.max - centres.min;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+		int half = count / 2;
+		std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [&](int a, int b)
+		{
+			return itemBounds[a].centre()[axis] < itemBounds[b].centre()[axis];
+		});
+
+		int left = (int)nodes.size();
+		nodes[index].left = left;
+
+		Node l = { AABB(), -1, first, half };
+		Node r = { AABB(), -1, first + half, count - half };
+		nodes.push_back(l);
+		nodes.push_back(r);
+
+		split(left);
+		split(left + 1);
+	}
+
+	void refit()
+	{
+		for (int i = (int)nodes.size() - 1; i >= 0; i--)
+		{
+			Node &node = nodes[i];
+			AABB bounds;
+
+			if (node.left < 0)
+			{
+				for (int j = node.first; j < node.first + node.count; j++)
+					bounds.expand(itemBounds[order[j]]);
+			}
+			else
+			{
+				bounds.expand(nodes[node.left].bounds);
+				bounds.expand(nodes[node.left + 1].bounds);
+			}
+
+			node.bounds = bounds;
+		}
+
+		stale = false;
+	}
+};
+
+// Culling results of the last frame
+struct CullStats
+{
+	unsigned int objects;	// drawables known to the culler
+	unsigned int visible;	// drawables submitted
+	unsigned int nodeTests;	// BVH nodes tested against the frustum
+	unsigned int refitted;	// drawables whose bounds moved
+	unsigned int portalCulled;	// drawables in view but in a cell hidden behind portals
+	bool rebuilt;		// the BVH was rebuilt rather than refit
+};
+
+// Keeps world-space bounds of a scene graph's drawables in a BVH and finds
+// the ones inside the view frustum, optionally narrowed further by portal
+// visibility. Only nodes the scene graph moved have their bounds recomputed.
+class SceneCuller
+{
+public:
+	CullStats stats;
+
+	SceneCuller()
+	{
+		stats.objects = stats.visible = stats.nodeTests = stats.refitted = stats.portalCulled = 0;
+		stats.rebuilt = false;
+	}
+
+	// Registers a scene node with the object-space bounds of what it draws and
+	// the portal cell it stands in, or -1 for none
+	void add(int node, const AABB &localBounds, int cell = -1)
+	{
+		Item item = { node, localBounds, bvh.insert((int)items.size(), AABB()), cell };
+		items.push_back(item);
+	}
+
+	// Refreshes the bounds of nodes moved by the last SceneGraph::update()
+	void update(const SceneGraph &scene)
+	{
+		stats.refitted = 0;
+
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			if (!scene.moved(items[i].node))
+				continue;
+
+			bvh.setBounds(items[i].slot, items[i].local.transformed(scene.worldMatrix(items[i].node)));
+			stats.refitted++;
+		}
+
+		stats.rebuilt = bvh.update();
+		stats.objects = bvh.size();
+	}
+
+	// Returns the visible nodes in ascending order, i.e. in draw order. With
+	// portals, which must be updated for the same view, nodes in cells that
+	// cannot be seen, or only outside the portals they are seen through, are dropped.
+	const std::vector<int> &cull(const glm::mat4 &viewProjection, const PortalVisibility *portals = NULL)
+	{
+		visibleItems.clear();
+		visibleNodes.clear();
+		stats.nodeTests = bvh.cull(Frustum(viewProjection), visibleItems);
+		stats.portalCulled = 0;
+
+		for (size_t i = 0; i < visibleItems.size(); i++)
+		{
+			const Item &item = items[visibleItems[i]];
+			if (portals && !portals->visible(item.cell, bvh.bounds(item.slot)))
+			{
+				stats.portalCulled++;
+				continue;
+			}
+			visibleNodes.push_back(item.node);
+		}
+
+		std::sort(visibleNodes.begin(), visibleNodes.end());
+		stats.visible = (unsigned int)visibleNodes.size();
+
+		return visibleNodes;
+	}
+
+	// Whether a node was found visible by the last cull()
+	bool visible(int node) const
+	{
+		return std::binary_search(visibleNodes.begin(), visibleNodes.end(), node);
+	}
+
+private:
+	struct Item
+	{
+		int node;
+		AABB local;
+		int slot;
+		int cell;
+	};
+
+	BVH bvh;			// holds indices into items
+	std::vector<Item> items;
+	std::vector<int> visibleItems;
+	std::vector<int> visibleNodes;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include "gl_state.h"
+#include "mesh_library.h"
+
+// Texture units the light passes read the G-buffer from; 0-3 hold the diffuse maps and point lights
+const unsigned int GBUFFER_ALBEDO_UNIT = 4;
+const unsigned int GBUFFER_NORMAL_UNIT = 5;
+const unsigned int GBUFFER_DEPTH_UNIT = 6;
+
+// Deferred shading. The geometry pass (gbuffer.fs) writes each visible
+// surface once into a 12-byte G-buffer, plus depth:
+//
+//	albedo		RGBA8		diffuse colour, specular strength
+//	normal		RGB10_A2	octahedral normal, shininess / 256
+//	light		RGBA8		light accumulated so far, starting with the material's own ambient
+//	depth		DEPTH24_STENCIL8
+//
+// The light passes then add to the light target: one fullscreen triangle
+// for the scene ambient and the carried lantern, and a sphere per point
+// light covering its range, so each light only shades the pixels it can
+// reach, however many surfaces were drawn over each other there. Positions
+// are rebuilt from depth. The result is blitted, with depth, to the window.
+class DeferredRenderer
+{
+public:
+	// G-buffer framebuffer, and the light pass framebuffer that only writes the light target
+	unsigned int FBO[2];
+
+	// Albedo, normal, light and depth textures
+	unsigned int textures[4];
+
+	// Light volumes over the mesh pool's buffers, without its instance attributes
+	unsigned int volumeVAO;
+
+	// Attribute-less VAO for the fullscreen triangle
+	unsigned int emptyVAO;
+
+	DeferredRenderer(const MeshPool &pool, const Mesh &sphere) : sphere(sphere), width(0), height(0)
+	{
+		glGenFramebuffers(2, FBO);
+		glGenTextures(4, textures);
+		glGenVertexArrays(1, &volumeVAO);
+		glGenVertexArrays(1, &emptyVAO);
+
+		glState().bindVertexArray(volumeVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, pool.VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.IBO);
+		setVertexAttributes(pool.vertexFormat());
+		glState().bindVertexArray(0);
+	}
+
+	DeferredRenderer(const DeferredRenderer&) = delete;
+	DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+	// (Re)allocates the G-buffer when the framebuffer size changes
+	void resize(int newWidth, int newHeight)
+	{
+		if (newWidth == width && newHeight == height)
+			return;
+
+		width = newWidth;
+		height = newHeight;
+
+		const GLenum internalFormats[4] = { GL_RGBA8, GL_RGB10_A2, GL_RGBA8, GL_DEPTH24_STENCIL8 };
+		const GLenum formats[4] = { GL_RGBA, GL_RGBA, GL_RGBA, GL_DEPTH_STENCIL };
+		const GLenum types[4] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_INT_2_10_10_10_REV, GL_UNSIGNED_BYTE, GL_UNSIGNED_INT_24_8 };
+
+		for (int i = 0; i < 4; i++)
+		{
+			glState().bindTexture(GL_TEXTURE_2D, textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		}
+		glState().bindTexture(GL_TEXTURE_2D, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[0]);
+		for (int i = 0; i < 3; i++)
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, textures[3], 0);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::DEFERRED::GBUFFER_INCOMPLETE" << std::endl;
+
+		// the light passes sample depth, so it must not be attached while they draw
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[1]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[2], 0);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::DEFERRED::LIGHT_TARGET_INCOMPLETE" << std::endl;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Binds and clears the G-buffer; the light target starts at the clear colour
+	void beginGeometry(const float clearColour[4])
+	{
+		const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+		const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		const float farDepth = 1.0f;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[0]);
+		glDrawBuffers(3, drawBuffers);
+
+		glClearBufferfv(GL_COLOR, 0, zero);
+		glClearBufferfv(GL_COLOR, 1, zero);
+		glClearBufferfv(GL_COLOR, 2, clearColour);
+		glClearBufferfi(GL_DEPTH_STENCIL, 0, farDepth, 0);
+	}
+
+	// Switches to the light target with additive blending and the G-buffer bound for reading
+	void beginLighting()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[1]);
+
+		GLStateCache &state = glState();
+		state.bindTexture(GBUFFER_ALBEDO_UNIT, GL_TEXTURE_2D, textures[0]);
+		state.bindTexture(GBUFFER_NORMAL_UNIT, GL_TEXTURE_2D, textures[1]);
+		state.bindTexture(GBUFFER_DEPTH_UNIT, GL_TEXTURE_2D, textures[3]);
+
+		state.setEnabled(GL_DEPTH_TEST, false);
+		state.depthMask(false);
+		state.setEnabled(GL_BLEND, true);
+		state.blendFunc(GL_ONE, GL_ONE);
+	}
+
+	// Scene ambient and the carried lantern, with the ambient program in use
+	void drawAmbient()
+	{
+		glState().bindVertexArray(emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	// One sphere per point light, with the light volume program in use
+	void drawLightVolumes(unsigned int lightCount)
+	{
+		if (lightCount == 0)
+			return;
+
+		// back faces only, so a sphere still shades when the camera is inside it;
+		// depth clamp keeps spheres reaching past the far plane from being cut open
+		GLStateCache &state = glState();
+		state.setEnabled(GL_CULL_FACE, true);
+		state.cullFace(GL_FRONT);
+		state.setEnabled(GL_DEPTH_CLAMP, true);
+
+		state.bindVertexArray(volumeVAO);
+		sphere.drawInstanced(lightCount);
+
+		state.setEnabled(GL_DEPTH_CLAMP, false);
+		state.cullFace(GL_BACK);
+		state.setEnabled(GL_CULL_FACE, false);
+	}
+
+	// Restores the forward state and copies the lit image and depth to the window
+	void finish()
+	{
+		GLStateCache &state = glState();
+		state.setEnabled(GL_BLEND, false);
+		state.depthMask(true);
+		state.setEnabled(GL_DEPTH_TEST, true);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO[0]);
+		glReadBuffer(GL_COLOR_ATTACHMENT2);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+private:
+	Mesh sphere;
+	int width, height;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#version 330 core
+
+struct Light {
+	vec3 position;
+	
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	float falloff;
+};
+
+out vec4 FragColour;
+
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	Light light;
+};
+
+// G-buffer, see deferred.h
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+
+// distance from the lantern to the nearest caster in every direction, see point_shadow.h
+uniform samplerCubeShadow shadowMap;
+uniform float shadowFar;
+
+// 1 where the lantern reaches the fragment, 0 in its shadow
+float lanternShadow(vec3 fragPos, vec3 norm)
+{
+	vec3 fromLight = fragPos - light.position;
+	float dist = length(fromLight);
+
+	// a larger bias on surfaces the light grazes
+	float bias = 0.02 + 0.05 * (1.0 - max(dot(norm, -fromLight / dist), 0.0));
+	return texture(shadowMap, vec4(fromLight, min((dist - bias) / shadowFar, 1.0)));
+}
+
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+
+	// nothing was drawn here
+	if (depth == 1.0)
+		discard;
+
+	vec4 albedoSpecular = texelFetch(gAlbedo, pixel, 0);
+	vec4 normalShininess = texelFetch(gNormal, pixel, 0);
+	vec3 diffuseColour = albedoSpecular.rgb;
+	vec3 norm = decodeNormal(normalShininess.xy);
+	float shininess = normalShininess.z * 256.0;
+
+	vec4 ndc = vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth, 1.0) * 2.0 - 1.0;
+	vec4 world = inverseViewProjection * ndc;
+	vec3 FragPos = world.xyz / world.w;
+
+	// calculate distance to the light
+	float lightDist = length(FragPos - light.position);
+	float attenuation = clamp( light.falloff / pow(lightDist, 2.0), 0.0, 1.0) * lanternShadow(FragPos, norm);
+
+	// ambient
+	vec3 ambient = light.ambient * diffuseColour;
+
+	// diffuse
+	vec3 lightDir = normalize(light.position - FragPos);
+	float diff = max(dot(norm, lightDir), 0.0);
+	vec3 diffuse = light.diffuse * diff * diffuseColour * attenuation;
+
+	// specular
+	vec3 viewDir = normalize(viewPos - FragPos);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+	vec3 specular = light.specular * spec * albedoSpecular.a * attenuation;
+
+	FragColour = vec4(ambient + diffuse + specular, 0.0);
+}
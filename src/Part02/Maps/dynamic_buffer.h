@@ -0,0 +1,246 @@
+#ifndef DYNAMIC_BUFFER_H
+#define DYNAMIC_BUFFER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <vector>
+
+#include "gl_extensions.h"
+
+// ARB_buffer_storage is core only from GL 4.4, so a 3.3 loader may not know it
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// Frames the CPU may get ahead of the GPU before it waits
+const unsigned int DYNAMIC_BUFFER_FRAMES = 3;
+
+// Ring buffer for data rewritten every frame: instance attributes, uniform
+// blocks, streamed vertices. With ARB_buffer_storage the buffer is mapped
+// once, persistently and coherently, and split into one region per frame
+// in flight; allocate() hands out pointers into the current region that are
+// filled with plain memcpy, and a fence per region keeps the CPU from
+// overwriting one the GPU may still read. Without it the buffer falls back
+// to orphaning: writes go to a CPU copy, and commit() sends what was
+// written since the last commit to storage orphaned at beginFrame().
+//
+// Every frame: beginFrame(), then allocate() (and commit() before the GPU
+// uses the data), then endFrame() after the last draw reading it.
+class DynamicBuffer
+{
+public:
+	// Buffer ID
+	unsigned int ID;
+
+	struct Stats
+	{
+		unsigned int fenceWaits;	// frames that had to wait for the GPU, since creation
+		unsigned int overflows;		// allocations that didn't fit their frame, since creation
+	};
+
+	Stats stats;
+
+	DynamicBuffer(size_t frameSize) : ID(0), mapped(NULL), size(0), region(0), head(0), committed(0), overflowed(false), bufferStorage(NULL)
+	{
+		stats.fenceWaits = stats.overflows = 0;
+
+		for (unsigned int i = 0; i < DYNAMIC_BUFFER_FRAMES; i++)
+			fences[i] = 0;
+
+		if (hasGLExtension("GL_ARB_buffer_storage"))
+			bufferStorage = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+
+		allocateStorage(frameSize);
+	}
+
+	DynamicBuffer(const DynamicBuffer&) = delete;
+	DynamicBuffer& operator=(const DynamicBuffer&) = delete;
+
+	// Deletes the fences; like the buffer, they must go while the context is still alive
+	void deleteFences()
+	{
+		for (unsigned int i = 0; i < DYNAMIC_BUFFER_FRAMES; i++)
+		{
+			if (fences[i])
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	// Whether writes go straight to a persistent mapping rather than through orphaning
+	bool persistent() const
+	{
+		return mapped != NULL;
+	}
+
+	// Bytes each frame can allocate
+	size_t frameSize() const
+	{
+		return size;
+	}
+
+	// Moves on to the next frame's region, waiting if the GPU is still reading it;
+	// a frame that overflowed makes the next one twice as large
+	void beginFrame()
+	{
+		if (overflowed)
+		{
+			waitAll();
+			allocateStorage(size * 2);
+		}
+
+		if (persistent())
+		{
+			region = (region + 1) % DYNAMIC_BUFFER_FRAMES;
+			wait(region);
+			head = region * size;
+		}
+		else
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+			glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			head = 0;
+		}
+
+		committed = head;
+	}
+
+	// Reserves bytes in this frame's region; returns where to write them and,
+	// in offset, where they sit in the buffer. NULL when the region is full.
+	void *allocate(size_t bytes, size_t alignment, size_t &offset)
+	{
+		size_t start = (head + alignment - 1) / alignment * alignment;
+		size_t end = persistent() ? (region + 1) * size : size;
+
+		if (start + bytes > end)
+		{
+			stats.overflows++;
+			overflowed = true;
+			return NULL;
+		}
+
+		head = start + bytes;
+		offset = start;
+		return persistent() ? mapped + start : &staging[0] + start;
+	}
+
+	// Makes everything allocated so far visible to the GPU; a coherent mapping already is
+	void commit()
+	{
+		if (persistent() || head == committed)
+			return;
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, committed, head - committed, &staging[committed]);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		committed = head;
+	}
+
+	// Fences this frame's region after the last command reading it
+	void endFrame()
+	{
+		commit();
+
+		if (!persistent())
+			return;
+
+		if (fences[region])
+			glDeleteSync(fences[region]);
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+private:
+	typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+	unsigned char *mapped;		// persistent mapping of all regions, or NULL when orphaning
+	std::vector<unsigned char> staging;	// CPU copy written when orphaning
+	size_t size;			// bytes per region
+	unsigned int region;
+	size_t head;			// next free byte
+	size_t committed;		// bytes before this were sent by commit()
+	bool overflowed;
+	GLsync fences[DYNAMIC_BUFFER_FRAMES];
+	BufferStorageProc bufferStorage;
+
+	// (Re)creates the buffer with regions of frameSize bytes
+	void allocateStorage(size_t frameSize)
+	{
+		if (ID)
+			glDeleteBuffers(1, &ID);
+
+		size = frameSize;
+		overflowed = false;
+		mapped = NULL;
+		region = 0;
+		head = committed = 0;
+
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+
+		if (bufferStorage)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			bufferStorage(GL_COPY_WRITE_BUFFER, size * DYNAMIC_BUFFER_FRAMES, NULL, flags);
+			mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size * DYNAMIC_BUFFER_FRAMES, flags);
+
+			if (!mapped)
+				std::cout << "ERROR::DYNAMIC_BUFFER::MAP_FAILED, orphaning instead" << std::endl;
+		}
+
+		if (!mapped)
+		{
+			// immutable storage can't be respecified, so orphaning needs a fresh buffer
+			if (bufferStorage)
+			{
+				glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+				glDeleteBuffers(1, &ID);
+				glGenBuffers(1, &ID);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+				bufferStorage = NULL;
+			}
+
+			glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+			staging.resize(size);
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	// Blocks until the GPU is done with a region
+	void wait(unsigned int r)
+	{
+		if (!fences[r])
+			return;
+
+		GLenum result = glClientWaitSync(fences[r], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			stats.fenceWaits++;
+
+			// flush on the first real wait, so the fence is sure to be reached
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			do
+			{
+				result = glClientWaitSync(fences[r], flags, 1000000);
+				flags = 0;
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+
+		glDeleteSync(fences[r]);
+		fences[r] = 0;
+	}
+
+	void waitAll()
+	{
+		for (unsigned int r = 0; r < DYNAMIC_BUFFER_FRAMES; r++)
+			wait(r);
+	}
+};
+
+#endif
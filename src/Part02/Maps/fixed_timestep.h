@@ -0,0 +1,103 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Fixed-rate simulation clock. Each frame's real time goes into an
+// accumulator that is drained in whole ticks, so the simulation advances by
+// the same step however fast or slow frames are rendered:
+//
+//	clock.advance(frameTime);
+//	while (clock.tick())
+//		simulate(clock.step());
+//	render(clock.alpha());
+//
+// Rendering runs up to one tick behind the simulation and blends the last
+// two ticks by alpha(), so motion stays smooth when frames and ticks don't
+// line up.
+class FixedTimestep
+{
+public:
+	FixedTimestep(float ticksPerSecond, unsigned int maxTicksPerFrame = 8) : dt(1.0f / ticksPerSecond), maxTicks(maxTicksPerFrame), accumulator(0.0f), count(0) {}
+
+	// Adds a frame's real time. A frame longer than maxTicksPerFrame ticks (a
+	// breakpoint, a window being dragged) is cut short rather than replayed,
+	// so the simulation slows down instead of falling further behind
+	void advance(float frameTime)
+	{
+		if (frameTime < 0.0f)
+			frameTime = 0.0f;
+		if (frameTime > maxTicks * dt)
+			frameTime = maxTicks * dt;
+
+		accumulator += frameTime;
+	}
+
+	// Consumes one tick if a whole one is owed
+	bool tick()
+	{
+		if (accumulator < dt)
+			return false;
+
+		accumulator -= dt;
+		count++;
+		return true;
+	}
+
+	// Seconds per tick
+	float step() const
+	{
+		return dt;
+	}
+
+	// How far rendering is from the previous tick to the latest one, in [0, 1)
+	float alpha() const
+	{
+		return accumulator / dt;
+	}
+
+	// Simulated seconds so far
+	double time() const
+	{
+		return (double)count * dt;
+	}
+
+	unsigned long long ticks() const
+	{
+		return count;
+	}
+
+private:
+	float dt;
+	unsigned int maxTicks;
+	float accumulator;
+	unsigned long long count;
+};
+
+// A simulated value kept for the last two ticks so rendering can blend them
+template <typename T>
+struct Interpolated
+{
+	T previous;
+	T current;
+
+	Interpolated(const T &value = T()) : previous(value), current(value) {}
+
+	// Call at the start of every tick, before the simulation changes current
+	void store()
+	{
+		previous = current;
+	}
+
+	// Moves both ticks by the same amount, e.g. to wrap an angle without a visible jump
+	void shift(const T &offset)
+	{
+		previous += offset;
+		current += offset;
+	}
+
+	T at(float alpha) const
+	{
+		return previous + (current - previous) * alpha;
+	}
+};
+
+#endif
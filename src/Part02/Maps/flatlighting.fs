@@ -2,11 +2,12 @@
 
 struct Material {
 	vec3 ambient;
-	sampler2D diffuse;
 	vec3 specular;
 	float shininess;
 };
 
+const int MAX_MATERIALS = 8;
+
 struct Light {
 	vec3 position;
 	
@@ -20,34 +21,109 @@ struct Light {
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
+flat in int MaterialIndex;
+flat in int Layer;
 
 out vec4 FragColour;
 
-uniform vec3 viewPos;
-uniform Material material;
-uniform Light light;
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	Light light;
+};
+
+// every diffuse texture of the scene, one per layer
+uniform sampler2DArray diffuseMaps;
+uniform Material materials[MAX_MATERIALS];
+
+// distance from the lantern to the nearest caster in every direction, see point_shadow.h
+uniform samplerCubeShadow shadowMap;
+uniform float shadowFar;
+
+// 1 where the lantern reaches the fragment, 0 in its shadow
+float lanternShadow(vec3 norm)
+{
+	vec3 fromLight = FragPos - light.position;
+	float dist = length(fromLight);
+
+	// a larger bias on surfaces the light grazes
+	float bias = 0.02 + 0.05 * (1.0 - max(dot(norm, -fromLight / dist), 0.0));
+	return texture(shadowMap, vec4(fromLight, min((dist - bias) / shadowFar, 1.0)));
+}
+
+// clustered point lights, see clustered_lights.h
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24);
+
+uniform samplerBuffer pointLights;	// 4 texels per light
+uniform usamplerBuffer lightClusters;	// first index and count per cluster
+uniform usamplerBuffer lightIndices;
+uniform vec4 clusterParams;		// tiles per pixel, then log(depth) to slice scale and bias
+
+// Diffuse and specular from one point light
+vec3 pointLight(int index, Material material, vec3 diffuseColour, vec3 norm, vec3 viewDir)
+{
+	vec4 positionFalloff = texelFetch(pointLights, index * 4);
+	vec4 diffuseConstant = texelFetch(pointLights, index * 4 + 1);
+	vec4 specularLinear = texelFetch(pointLights, index * 4 + 2);
+	vec4 quadraticRange = texelFetch(pointLights, index * 4 + 3);
+
+	float lightDist = length(positionFalloff.xyz - FragPos);
+	if (lightDist > quadraticRange.y)
+		return vec3(0.0);
+
+	// the lantern's falloff when set, otherwise constant, linear and quadratic terms
+	float attenuation;
+	if (positionFalloff.w > 0.0)
+		attenuation = clamp(positionFalloff.w / pow(lightDist, 2.0), 0.0, 1.0);
+	else
+		attenuation = 1.0 / (diffuseConstant.w + specularLinear.w * lightDist + quadraticRange.x * lightDist * lightDist);
+
+	vec3 lightDir = normalize(positionFalloff.xyz - FragPos);
+	float diff = max(dot(norm, lightDir), 0.0);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+
+	return (diffuseConstant.rgb * diff * diffuseColour + specularLinear.rgb * spec * material.specular) * attenuation;
+}
 
 void main()
 {
+	Material material = materials[MaterialIndex];
+	vec3 diffuseColour = texture(diffuseMaps, vec3(TexCoords, Layer)).rgb;
+
 	// calculate distance to the light
 	float lightDist = length(FragPos - light.position);
 	float attenuation = clamp( light.falloff / pow(lightDist, 2.0), 0.0, 1.0);
 
 	// ambient
-    vec3 ambient = (light.ambient + material.ambient) * texture(material.diffuse, TexCoords).rgb;
+    vec3 ambient = (light.ambient + material.ambient) * diffuseColour;
 
     // diffuse
     vec3 norm = normalize(Normal);
+    float shadow = lanternShadow(norm);
     vec3 lightDir = normalize(light.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb * attenuation;
+    vec3 diffuse = light.diffuse * diff * diffuseColour * attenuation * shadow;
 
     // specular
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * spec * material.specular * attenuation;
+    vec3 specular = light.specular * spec * material.specular * attenuation * shadow;
 
     vec3 result = ambient + diffuse + specular;
+
+	// only the lights assigned to this fragment's cluster
+	float depth = -(view * vec4(FragPos, 1.0)).z;
+	ivec3 cluster = ivec3(gl_FragCoord.xy * clusterParams.xy, log(max(depth, 1e-4)) * clusterParams.z + clusterParams.w);
+	cluster = clamp(cluster, ivec3(0), CLUSTER_GRID - 1);
+
+	uvec2 range = texelFetch(lightClusters, (cluster.z * CLUSTER_GRID.y + cluster.y) * CLUSTER_GRID.x + cluster.x).xy;
+	for (uint i = 0u; i < range.y; i++)
+		result += pointLight(int(texelFetch(lightIndices, int(range.x + i)).r), material, diffuseColour, norm, viewDir);
+
     FragColour = vec4(result, 1.0);
 }
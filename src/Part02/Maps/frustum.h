@@ -0,0 +1,112 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <math.h>
+
+#include "mesh_library.h"
+
+// Axis-aligned bounding box
+struct AABB
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	AABB() : min(1e30f), max(-1e30f) {}
+	AABB(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {}
+
+	// Object-space bounds of a pooled mesh
+	explicit AABB(const Mesh &mesh) : min(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]), max(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]) {}
+
+	void expand(const AABB &other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	glm::vec3 centre() const
+	{
+		return (min + max) * 0.5f;
+	}
+
+	float surfaceArea() const
+	{
+		glm::vec3 size = max - min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// Bounds of this box after a transform, without transforming all eight corners
+	AABB transformed(const glm::mat4 &m) const
+	{
+		glm::vec3 c = centre(), e = (max - min) * 0.5f;
+		glm::vec3 worldCentre(m * glm::vec4(c, 1.0f));
+		glm::vec3 worldExtent;
+
+		for (int i = 0; i < 3; i++)
+			worldExtent[i] = fabsf(m[0][i]) * e.x + fabsf(m[1][i]) * e.y + fabsf(m[2][i]) * e.z;
+
+		return AABB(worldCentre - worldExtent, worldCentre + worldExtent);
+	}
+};
+
+enum FrustumTest
+{
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECTS,
+	FRUSTUM_INSIDE
+};
+
+// The six clip planes of a projection * view matrix, pointing inwards
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	Frustum() {}
+
+	// The side planes can be pulled in to a rectangle of normalized device
+	// coordinates, e.g. the screen area of a portal
+	explicit Frustum(const glm::mat4 &viewProjection, float minX = -1.0f, float minY = -1.0f, float maxX = 1.0f, float maxY = 1.0f)
+	{
+		// rows of the matrix; glm stores columns
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+		// left, right, bottom, top: x >= minX * w, x <= maxX * w and the same for y
+		planes[0] = rows[0] - rows[3] * minX;
+		planes[1] = rows[3] * maxX - rows[0];
+		planes[2] = rows[1] - rows[3] * minY;
+		planes[3] = rows[3] * maxY - rows[1];
+
+		// near, far
+		planes[4] = rows[3] + rows[2];
+		planes[5] = rows[3] - rows[2];
+
+		for (int i = 0; i < 6; i++)
+			planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+	}
+
+	FrustumTest test(const AABB &box) const
+	{
+		FrustumTest result = FRUSTUM_INSIDE;
+
+		for (int i = 0; i < 6; i++)
+		{
+			const glm::vec4 &p = planes[i];
+
+			// the corner furthest along the plane normal, and the one furthest against it
+			glm::vec3 positive(p.x >= 0.0f ? box.max.x : box.min.x, p.y >= 0.0f ? box.max.y : box.min.y, p.z >= 0.0f ? box.max.z : box.min.z);
+			glm::vec3 negative(p.x >= 0.0f ? box.min.x : box.max.x, p.y >= 0.0f ? box.min.y : box.max.y, p.z >= 0.0f ? box.min.z : box.max.z);
+
+			if (glm::dot(glm::vec3(p), positive) + p.w < 0.0f)
+				return FRUSTUM_OUTSIDE;
+			if (glm::dot(glm::vec3(p), negative) + p.w < 0.0f)
+				result = FRUSTUM_INTERSECTS;
+		}
+
+		return result;
+	}
+};
+
+#endif
@@ -0,0 +1,45 @@
+#version 330 core
+
+struct Material {
+	vec3 ambient;
+	vec3 specular;
+	float shininess;
+};
+
+const int MAX_MATERIALS = 8;
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoords;
+flat in int MaterialIndex;
+flat in int Layer;
+
+// G-buffer targets, see deferred.h
+layout (location = 0) out vec4 AlbedoSpecular;
+layout (location = 1) out vec4 NormalShininess;
+layout (location = 2) out vec4 Light;
+
+// every diffuse texture of the scene, one per layer
+uniform sampler2DArray diffuseMaps;
+uniform Material materials[MAX_MATERIALS];
+
+// Octahedral encoding: the unit sphere folded onto a square, mapped to [0, 1]
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+
+void main()
+{
+	Material material = materials[MaterialIndex];
+	vec3 diffuseColour = texture(diffuseMaps, vec3(TexCoords, Layer)).rgb;
+
+	// materials are grey, so one specular strength is enough
+	AlbedoSpecular = vec4(diffuseColour, dot(material.specular, vec3(1.0 / 3.0)));
+	NormalShininess = vec4(encodeNormal(normalize(Normal)), material.shininess / 256.0, 0.0);
+
+	// the material's own ambient; the light passes add the rest
+	Light = vec4(material.ambient * diffuseColour, 1.0);
+}
@@ -0,0 +1,24 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string.h>
+
+// Whether the context reports an extension, e.g. "GL_ARB_buffer_storage"
+inline bool hasGLExtension(const char *name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+#endif
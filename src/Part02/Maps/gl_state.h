@@ -0,0 +1,265 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Texture units the cache tracks; binds to higher units are always made
+const unsigned int GL_STATE_TEXTURE_UNITS = 16;
+
+// Remembers the program, vertex array, texture and sampler bindings and the
+// depth, blend and cull state last set through it, and drops calls that
+// would set them to what they already are. Only works if every change of
+// that state goes through the cache; after code that bypasses it, or after
+// deleting a bound object whose name may be reused, call reset().
+//
+// Counts the calls it made and skipped each frame, so the driver overhead
+// saved can be read off lastFrame.
+class GLStateCache
+{
+public:
+	struct Stats
+	{
+		unsigned int calls;	// state calls passed on to GL
+		unsigned int elided;	// redundant ones dropped
+	};
+
+	Stats stats;		// this frame so far
+	Stats lastFrame;	// the whole previous frame
+
+	GLStateCache()
+	{
+		stats.calls = stats.elided = 0;
+		lastFrame = stats;
+		reset();
+	}
+
+	GLStateCache(const GLStateCache&) = delete;
+	GLStateCache& operator=(const GLStateCache&) = delete;
+
+	void beginFrame()
+	{
+		lastFrame = stats;
+		stats.calls = stats.elided = 0;
+	}
+
+	// Forgets all state, so the next call of every kind is made
+	void reset()
+	{
+		program = vertexArray = activeUnit = UNKNOWN;
+
+		for (unsigned int u = 0; u < GL_STATE_TEXTURE_UNITS; u++)
+		{
+			for (int t = 0; t < TARGET_COUNT; t++)
+				textures[u][t] = UNKNOWN;
+			samplers[u] = UNKNOWN;
+		}
+
+		for (int c = 0; c < CAPABILITY_COUNT; c++)
+			capabilities[c] = UNKNOWN;
+
+		depthWrite = blendSource = blendDestination = cullMode = UNKNOWN;
+	}
+
+	void useProgram(unsigned int id)
+	{
+		if (!changes(program, id))
+			return;
+		glUseProgram(id);
+	}
+
+	void bindVertexArray(unsigned int id)
+	{
+		if (!changes(vertexArray, id))
+			return;
+		glBindVertexArray(id);
+	}
+
+	// Selects a texture unit by number, not by GL_TEXTUREi
+	void activeTexture(unsigned int unit)
+	{
+		if (!changes(activeUnit, unit))
+			return;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	// Binds to the active unit, like glBindTexture
+	void bindTexture(GLenum target, unsigned int id)
+	{
+		int t = targetIndex(target);
+
+		if (activeUnit < GL_STATE_TEXTURE_UNITS && t >= 0)
+		{
+			if (!changes(textures[activeUnit][t], id))
+				return;
+		}
+		else
+		{
+			// with the unit unknown, any unit's binding of the target may be the one changing
+			if (activeUnit == UNKNOWN && t >= 0)
+			{
+				for (unsigned int u = 0; u < GL_STATE_TEXTURE_UNITS; u++)
+					textures[u][t] = UNKNOWN;
+			}
+			stats.calls++;
+		}
+
+		glBindTexture(target, id);
+	}
+
+	// Binds to a given unit, switching units only if the binding there changes
+	void bindTexture(unsigned int unit, GLenum target, unsigned int id)
+	{
+		int t = targetIndex(target);
+
+		if (unit < GL_STATE_TEXTURE_UNITS && t >= 0 && textures[unit][t] == id)
+		{
+			stats.elided++;
+			return;
+		}
+
+		activeTexture(unit);
+		bindTexture(target, id);
+	}
+
+	// Deletes a texture; GL unbinds it from every unit, and so does the cache,
+	// so a texture that later reuses the name is bound again
+	void deleteTexture(unsigned int id)
+	{
+		for (unsigned int u = 0; u < GL_STATE_TEXTURE_UNITS; u++)
+		{
+			for (int t = 0; t < TARGET_COUNT; t++)
+			{
+				if (textures[u][t] == id)
+					textures[u][t] = 0;
+			}
+		}
+
+		glDeleteTextures(1, &id);
+	}
+
+	void bindSampler(unsigned int unit, unsigned int id)
+	{
+		if (unit < GL_STATE_TEXTURE_UNITS)
+		{
+			if (!changes(samplers[unit], id))
+				return;
+		}
+		else
+		{
+			stats.calls++;
+		}
+
+		glBindSampler(unit, id);
+	}
+
+	// glEnable or glDisable of GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE or GL_DEPTH_CLAMP
+	void setEnabled(GLenum capability, bool enabled)
+	{
+		int c = capabilityIndex(capability);
+
+		if (c >= 0)
+		{
+			if (!changes(capabilities[c], enabled ? 1u : 0u))
+				return;
+		}
+		else
+		{
+			stats.calls++;
+		}
+
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+	}
+
+	void depthMask(bool write)
+	{
+		if (!changes(depthWrite, write ? 1u : 0u))
+			return;
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+
+	void blendFunc(GLenum source, GLenum destination)
+	{
+		if (blendSource == source && blendDestination == destination)
+		{
+			stats.elided++;
+			return;
+		}
+
+		blendSource = source;
+		blendDestination = destination;
+		stats.calls++;
+		glBlendFunc(source, destination);
+	}
+
+	void cullFace(GLenum mode)
+	{
+		if (!changes(cullMode, mode))
+			return;
+		glCullFace(mode);
+	}
+
+private:
+	static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+	static const int TARGET_COUNT = 4;
+	static const int CAPABILITY_COUNT = 4;
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int activeUnit;
+	unsigned int textures[GL_STATE_TEXTURE_UNITS][TARGET_COUNT];
+	unsigned int samplers[GL_STATE_TEXTURE_UNITS];
+	unsigned int capabilities[CAPABILITY_COUNT];
+	unsigned int depthWrite;
+	unsigned int blendSource, blendDestination;
+	unsigned int cullMode;
+
+	// Stores value and returns true if it differs from what is cached, counting either way
+	bool changes(unsigned int &cached, unsigned int value)
+	{
+		if (cached == value)
+		{
+			stats.elided++;
+			return false;
+		}
+
+		cached = value;
+		stats.calls++;
+		return true;
+	}
+
+	static int targetIndex(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_2D_ARRAY: return 1;
+		case GL_TEXTURE_CUBE_MAP: return 2;
+		case GL_TEXTURE_BUFFER: return 3;
+		default: return -1;
+		}
+	}
+
+	static int capabilityIndex(GLenum capability)
+	{
+		switch (capability)
+		{
+		case GL_DEPTH_TEST: return 0;
+		case GL_BLEND: return 1;
+		case GL_CULL_FACE: return 2;
+		case GL_DEPTH_CLAMP: return 3;
+		default: return -1;
+		}
+	}
+};
+
+// The cache for the current context; these programs only ever make one
+inline GLStateCache &glState()
+{
+	static GLStateCache cache;
+	return cache;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+
+// Fixed-size ring buffer for one producer thread and one consumer thread.
+// Each side only writes its own index, so neither push nor pop takes a lock.
+// Capacity must be a power of two; one slot is kept empty to tell full from empty.
+template <typename T, unsigned int Capacity>
+class SPSCQueue
+{
+public:
+	SPSCQueue() : head(0), tail(0) {}
+
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+	// Producer side; returns false when the queue is full
+	bool push(const T &item)
+	{
+		unsigned int t = tail.load(std::memory_order_relaxed);
+		unsigned int next = (t + 1) & (Capacity - 1);
+		if (next == head.load(std::memory_order_acquire))
+			return false;
+
+		slots[t] = item;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side; returns false when the queue is empty
+	bool pop(T &item)
+	{
+		unsigned int h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+
+		item = slots[h];
+		head.store((h + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+private:
+	static_assert((Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+	T slots[Capacity];
+
+	// on separate cache lines, so the two threads don't keep stealing one from each other
+	alignas(64) std::atomic<unsigned int> head;
+	alignas(64) std::atomic<unsigned int> tail;
+};
+
+// A key GLFW reported, stamped with glfwGetTime() when it arrived
+struct InputEvent
+{
+	double time;
+	int key;	// GLFW key code
+	int action;	// GLFW_PRESS, GLFW_REPEAT or GLFW_RELEASE
+};
+
+// Event-driven input. GLFW's key callback pushes timestamped
+// events into a lock-free queue instead of the program polling every key
+// each frame. Keys are bound to program-defined actions; dispatch() drains
+// the queue and, for each action, counts the presses since the last
+// dispatch and measures how long it was held in that time. A tap shorter
+// than a frame is therefore neither missed nor stretched to a whole frame.
+// Call dispatch() every frame, even when the input goes unused, or the
+// queue fills up and drops events.
+class InputSystem
+{
+public:
+	static const int MAX_ACTIONS = 32;
+
+	struct Stats
+	{
+		unsigned int events;	// events handled by the last dispatch()
+		unsigned int dropped;	// events lost to a full queue so far
+	};
+
+	Stats stats;
+
+	InputSystem() : lastDispatch(0.0), dropped(0)
+	{
+		stats.events = stats.dropped = 0;
+
+		for (int k = 0; k <= GLFW_KEY_LAST; k++)
+		{
+			bindings[k] = -1;
+			keyDown[k] = false;
+		}
+
+		for (int a = 0; a < MAX_ACTIONS; a++)
+		{
+			actions[a].keysDown = 0;
+			actions[a].presses = 0;
+			actions[a].since = 0.0;
+			actions[a].held = 0.0f;
+		}
+	}
+
+	InputSystem(const InputSystem&) = delete;
+	InputSystem& operator=(const InputSystem&) = delete;
+
+	// Takes over the window's key callback and its user pointer
+	void attach(GLFWwindow *window)
+	{
+		glfwSetWindowUserPointer(window, this);
+		glfwSetKeyCallback(window, keyCallback);
+		lastDispatch = glfwGetTime();
+	}
+
+	// Makes a key trigger an action; several keys may share one action
+	void bind(int key, int action)
+	{
+		if (key >= 0 && key <= GLFW_KEY_LAST && action >= 0 && action < MAX_ACTIONS)
+			bindings[key] = action;
+	}
+
+	// Applies every queued event; now is the end of the time the presses and
+	// held times are measured over, normally glfwGetTime()
+	void dispatch(double now)
+	{
+		for (int a = 0; a < MAX_ACTIONS; a++)
+		{
+			actions[a].presses = 0;
+			actions[a].held = 0.0f;
+			actions[a].since = lastDispatch;
+		}
+
+		stats.events = 0;
+
+		InputEvent event;
+		while (queue.pop(event))
+		{
+			stats.events++;
+
+			// events raised before the last dispatch finished count from its end
+			double time = event.time < lastDispatch ? lastDispatch : (event.time > now ? now : event.time);
+
+			// repeats carry nothing a held key doesn't already say
+			if (event.action == GLFW_REPEAT || event.key < 0 || event.key > GLFW_KEY_LAST)
+				continue;
+
+			bool down = event.action == GLFW_PRESS;
+			if (down == keyDown[event.key])
+				continue;
+			keyDown[event.key] = down;
+
+			int a = bindings[event.key];
+			if (a < 0)
+				continue;
+
+			Action &action = actions[a];
+			if (down)
+			{
+				action.presses++;
+				if (action.keysDown++ == 0)
+					action.since = time;
+			}
+			else if (--action.keysDown == 0)
+			{
+				action.held += (float)(time - action.since);
+			}
+		}
+
+		for (int a = 0; a < MAX_ACTIONS; a++)
+		{
+			if (actions[a].keysDown > 0)
+				actions[a].held += (float)(now - actions[a].since);
+		}
+
+		stats.dropped = dropped.load(std::memory_order_relaxed);
+		lastDispatch = now;
+	}
+
+	// Times the action was pressed during the last dispatch() interval
+	unsigned int pressed(int action) const
+	{
+		return actions[action].presses;
+	}
+
+	// Whether any of the action's keys is held now
+	bool down(int action) const
+	{
+		return actions[action].keysDown > 0;
+	}
+
+	// Seconds the action was held during the last dispatch() interval
+	float heldFor(int action) const
+	{
+		return actions[action].held;
+	}
+
+private:
+	struct Action
+	{
+		int keysDown;		// bound keys currently held
+		unsigned int presses;
+		double since;		// when it was last pressed, or the interval start
+		float held;
+	};
+
+	SPSCQueue<InputEvent, 256> queue;
+	int bindings[GLFW_KEY_LAST + 1];	// action of each key, or -1
+	bool keyDown[GLFW_KEY_LAST + 1];
+	Action actions[MAX_ACTIONS];
+	double lastDispatch;
+	std::atomic<unsigned int> dropped;
+
+	void push(const InputEvent &event)
+	{
+		if (!queue.push(event))
+			dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void keyCallback(GLFWwindow *window, int key, int, int action, int)
+	{
+		InputEvent event = { glfwGetTime(), key, action };
+		static_cast<InputSystem*>(glfwGetWindowUserPointer(window))->push(event);
+	}
+};
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string.h>
+#include <vector>
+
+#include "dynamic_buffer.h"
+#include "gl_state.h"
+#include "mesh_library.h"
+
+// Attribute locations of the per-instance data (a mat4 takes four consecutive slots, a mat3 three)
+const unsigned int INSTANCE_MODEL_LOCATION = 3;
+const unsigned int INSTANCE_INDICES_LOCATION = 7;
+const unsigned int INSTANCE_NORMAL_LOCATION = 8;
+
+// Per-instance lookups, read by the shader as an ivec2
+struct InstanceIndices
+{
+	int material;	// index into the materials[] uniform array
+	int layer;	// layer of the diffuse texture array
+};
+
+// Matrix that takes object-space normals to world space. A rigid or uniformly
+// scaled transform only scales normals, which the shaders normalize anyway, so
+// its upper 3x3 is used as-is; anything else needs the inverse transpose.
+inline glm::mat3 computeNormalMatrix(const glm::mat4 &model, bool uniformScale)
+{
+	if (uniformScale)
+		return glm::mat3(model);
+
+	return glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+// A run of consecutive instances that share a mesh and a diffuse texture (array)
+struct InstanceBatch
+{
+	Mesh mesh;
+	unsigned int texture;
+	unsigned int first;
+	unsigned int count;
+};
+
+// Streams per-instance model matrices, normal matrices and InstanceIndices
+// and draws every batch with a single glDrawElementsInstancedBaseVertex call.
+//
+// The instance buffer holds three tightly packed regions, all model matrices,
+// then all normal matrices, then all indices, so each contiguous array can be
+// uploaded with one copy. Given a DynamicBuffer the regions are copied into
+// it instead, and the own buffer, orphaned on every upload, is only used
+// when the dynamic one is out of room for the frame.
+class InstanceRenderer
+{
+public:
+	// Instance buffer ID
+	unsigned int VBO;
+
+	// Number of draw calls issued since the last upload()
+	unsigned int drawCalls;
+
+	InstanceRenderer(unsigned int capacity = 256) : drawCalls(0), capacity(capacity), stream(NULL), source(0), modelsAt(0), normalsAt(0), indicesAt(0)
+	{
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, capacity * instanceSize(), NULL, GL_STREAM_DRAW);
+
+		useOwnBuffer();
+	}
+
+	InstanceRenderer(const InstanceRenderer&) = delete;
+	InstanceRenderer& operator=(const InstanceRenderer&) = delete;
+
+	// Adds the per-instance attributes (with a divisor of 1) to a mesh pool's VAO
+	void attach(unsigned int VAO)
+	{
+		glState().bindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+			glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+		}
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			glEnableVertexAttribArray(INSTANCE_NORMAL_LOCATION + i);
+			glVertexAttribDivisor(INSTANCE_NORMAL_LOCATION + i, 1);
+		}
+		glEnableVertexAttribArray(INSTANCE_INDICES_LOCATION);
+		glVertexAttribDivisor(INSTANCE_INDICES_LOCATION, 1);
+
+		setInstanceOffset(0);
+	}
+
+	// Streams instance data through a per-frame ring buffer from now on; NULL goes back to orphaning
+	void useDynamicBuffer(DynamicBuffer *buffer)
+	{
+		stream = buffer;
+	}
+
+	// Replaces the instance data with count model matrices, normal matrices and indices
+	void upload(const glm::mat4 *models, const glm::mat3 *normals, const InstanceIndices *indices, unsigned int count)
+	{
+		drawCalls = 0;
+
+		if (count == 0)
+			return;
+
+		size_t offset;
+		unsigned char *data = stream ? (unsigned char*)stream->allocate(count * instanceSize(), 16, offset) : NULL;
+
+		if (data)
+		{
+			modelsAt = offset;
+			normalsAt = modelsAt + count * sizeof(glm::mat4);
+			indicesAt = normalsAt + count * sizeof(glm::mat3);
+
+			memcpy(data, models, count * sizeof(glm::mat4));
+			memcpy(data + (normalsAt - offset), normals, count * sizeof(glm::mat3));
+			memcpy(data + (indicesAt - offset), indices, count * sizeof(InstanceIndices));
+			stream->commit();
+
+			source = stream->ID;
+			return;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+		// grow the buffer if needed, otherwise orphan it so the driver doesn't wait on last frame's draws
+		if (count > capacity)
+			capacity = count * 2;
+
+		glBufferData(GL_ARRAY_BUFFER, capacity * instanceSize(), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), models);
+		glBufferSubData(GL_ARRAY_BUFFER, normalsOffset(), count * sizeof(glm::mat3), normals);
+		glBufferSubData(GL_ARRAY_BUFFER, indicesOffset(), count * sizeof(InstanceIndices), indices);
+
+		useOwnBuffer();
+	}
+
+	// Draws batches of the uploaded instances with their diffuse texture array on
+	// unit 0; the state cache skips the VAO and array when they are already bound
+	void draw(const std::vector<InstanceBatch> &batches)
+	{
+		GLStateCache &state = glState();
+		glBindBuffer(GL_ARRAY_BUFFER, source);
+
+		for (size_t i = 0; i < batches.size(); i++)
+		{
+			const InstanceBatch &batch = batches[i];
+
+			state.bindVertexArray(batch.mesh.VAO);
+			state.bindTexture(0, GL_TEXTURE_2D_ARRAY, batch.texture);
+
+			// GL 3.3 has no base instance, so point the attributes at the batch's first instance instead
+			setInstanceOffset(batch.first);
+
+			batch.mesh.drawInstanced(batch.count);
+			drawCalls++;
+		}
+	}
+
+	// Queues one object for flush(); it joins the previous batch when mesh and texture match
+	void add(const Mesh &mesh, unsigned int texture, const glm::mat4 &model, const InstanceIndices &indices)
+	{
+		// nothing is known about an arbitrary matrix, so it takes the general path
+		add(mesh, texture, model, computeNormalMatrix(model, false), indices);
+	}
+
+	// Same, with a normal matrix that was already computed, e.g. by the scene graph
+	void add(const Mesh &mesh, unsigned int texture, const glm::mat4 &model, const glm::mat3 &normal, const InstanceIndices &indices)
+	{
+		if (queuedBatches.empty() || queuedBatches.back().mesh != mesh || queuedBatches.back().texture != texture)
+		{
+			InstanceBatch batch = { mesh, texture, (unsigned int)queuedModels.size(), 0 };
+			queuedBatches.push_back(batch);
+		}
+
+		queuedModels.push_back(model);
+		queuedNormals.push_back(normal);
+		queuedIndices.push_back(indices);
+		queuedBatches.back().count++;
+	}
+
+	// Uploads and draws everything queued with add()
+	void flush()
+	{
+		if (!queuedModels.empty())
+		{
+			upload(&queuedModels[0], &queuedNormals[0], &queuedIndices[0], (unsigned int)queuedModels.size());
+			draw(queuedBatches);
+		}
+
+		queuedModels.clear();
+		queuedNormals.clear();
+		queuedIndices.clear();
+		queuedBatches.clear();
+	}
+
+private:
+	unsigned int capacity;
+
+	DynamicBuffer *stream;
+	unsigned int source;	// buffer the last upload went to
+	size_t modelsAt, normalsAt, indicesAt;	// where in it each region starts
+
+	std::vector<glm::mat4> queuedModels;
+	std::vector<glm::mat3> queuedNormals;
+	std::vector<InstanceIndices> queuedIndices;
+	std::vector<InstanceBatch> queuedBatches;
+
+	static size_t instanceSize()
+	{
+		return sizeof(glm::mat4) + sizeof(glm::mat3) + sizeof(InstanceIndices);
+	}
+
+	size_t normalsOffset() const
+	{
+		return capacity * sizeof(glm::mat4);
+	}
+
+	size_t indicesOffset() const
+	{
+		return capacity * (sizeof(glm::mat4) + sizeof(glm::mat3));
+	}
+
+	void useOwnBuffer()
+	{
+		source = VBO;
+		modelsAt = 0;
+		normalsAt = normalsOffset();
+		indicesAt = indicesOffset();
+	}
+
+	// Points the instance attributes of the bound VAO at a given instance of the
+	// last upload; the buffer it went to must be bound to GL_ARRAY_BUFFER
+	void setInstanceOffset(unsigned int first)
+	{
+		size_t modelBase = modelsAt + first * sizeof(glm::mat4);
+		size_t normalBase = normalsAt + first * sizeof(glm::mat3);
+		size_t indicesBase = indicesAt + first * sizeof(InstanceIndices);
+
+		for (unsigned int i = 0; i < 4; i++)
+			glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(modelBase + i * sizeof(glm::vec4)));
+
+		for (unsigned int i = 0; i < 3; i++)
+			glVertexAttribPointer(INSTANCE_NORMAL_LOCATION + i, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)(normalBase + i * sizeof(glm::vec3)));
+
+		glVertexAttribIPointer(INSTANCE_INDICES_LOCATION, 2, GL_INT, sizeof(InstanceIndices), (void*)indicesBase);
+	}
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU work that fans out and joins within a
+// frame. run() hands out job numbers 0..count-1 to the workers and to the
+// calling thread, and returns once all of them have finished, so jobs may
+// read anything the caller set up and write only what their number owns.
+// Jobs must not touch GL; that stays on the thread owning the context.
+class JobPool
+{
+public:
+	JobPool(unsigned int threadCount = 0) : jobCount(0), nextJob(0), finished(0), generation(0), stopping(false)
+	{
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+
+		for (unsigned int i = 0; i < threadCount; i++)
+			workers.push_back(std::thread(&JobPool::work, this));
+	}
+
+	~JobPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	// Threads that can run jobs at once, counting the caller
+	unsigned int concurrency() const
+	{
+		return (unsigned int)workers.size() + 1;
+	}
+
+	// Calls job(i) for every i below count, spread over the pool, and waits for all of them
+	void run(unsigned int count, const std::function<void(unsigned int)> &job)
+	{
+		if (count == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = job;
+			jobCount = count;
+			nextJob = 0;
+			finished = 0;
+			generation++;
+		}
+		wake.notify_all();
+
+		// the caller takes jobs too instead of sitting idle
+		runJobs();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return finished == jobCount; });
+		current = std::function<void(unsigned int)>();
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	std::function<void(unsigned int)> current;
+	unsigned int jobCount;
+	unsigned int nextJob;
+	unsigned int finished;
+	unsigned int generation;	// bumped by every run(), so workers know there is new work
+	bool stopping;
+
+	// Takes jobs until none are left
+	void runJobs()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (nextJob < jobCount)
+		{
+			unsigned int job = nextJob++;
+			lock.unlock();
+			current(job);
+			lock.lock();
+
+			if (++finished == jobCount)
+				done.notify_all();
+		}
+	}
+
+	void work()
+	{
+		unsigned int seen = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping)
+					return;
+				seen = generation;
+			}
+
+			runJobs();
+		}
+	}
+};
+
+#endif
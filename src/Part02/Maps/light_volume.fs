@@ -0,0 +1,87 @@
+#version 330 core
+
+flat in int LightIndex;
+
+out vec4 FragColour;
+
+struct Light {
+	vec3 position;
+	
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	float falloff;
+};
+
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	Light light;
+};
+
+// 4 texels per light, see clustered_lights.h
+uniform samplerBuffer pointLights;
+
+// G-buffer, see deferred.h
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+
+	if (depth == 1.0)
+		discard;
+
+	vec4 ndc = vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth, 1.0) * 2.0 - 1.0;
+	vec4 world = inverseViewProjection * ndc;
+	vec3 FragPos = world.xyz / world.w;
+
+	vec4 positionFalloff = texelFetch(pointLights, LightIndex * 4);
+	vec4 diffuseConstant = texelFetch(pointLights, LightIndex * 4 + 1);
+	vec4 specularLinear = texelFetch(pointLights, LightIndex * 4 + 2);
+	vec4 quadraticRange = texelFetch(pointLights, LightIndex * 4 + 3);
+
+	// the sphere covers more than the range; skip what it covers outside it
+	float lightDist = length(positionFalloff.xyz - FragPos);
+	if (lightDist > quadraticRange.y)
+		discard;
+
+	vec4 albedoSpecular = texelFetch(gAlbedo, pixel, 0);
+	vec4 normalShininess = texelFetch(gNormal, pixel, 0);
+	vec3 norm = decodeNormal(normalShininess.xy);
+	float shininess = normalShininess.z * 256.0;
+
+	// the lantern's falloff when set, otherwise constant, linear and quadratic terms
+	float attenuation;
+	if (positionFalloff.w > 0.0)
+		attenuation = clamp(positionFalloff.w / pow(lightDist, 2.0), 0.0, 1.0);
+	else
+		attenuation = 1.0 / (diffuseConstant.w + specularLinear.w * lightDist + quadraticRange.x * lightDist * lightDist);
+
+	vec3 lightDir = normalize(positionFalloff.xyz - FragPos);
+	float diff = max(dot(norm, lightDir), 0.0);
+	vec3 viewDir = normalize(viewPos - FragPos);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+
+	vec3 result = (diffuseConstant.rgb * diff * albedoSpecular.rgb + specularLinear.rgb * spec * albedoSpecular.a) * attenuation;
+	FragColour = vec4(result, 0.0);
+}
@@ -0,0 +1,37 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+struct Light {
+	vec3 position;
+	
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	float falloff;
+};
+
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	Light light;
+};
+
+// the clustered point lights, 4 texels per light; one instance per light
+uniform samplerBuffer pointLights;
+
+flat out int LightIndex;
+
+void main()
+{
+	vec3 position = texelFetch(pointLights, gl_InstanceID * 4).xyz;
+	float range = min(texelFetch(pointLights, gl_InstanceID * 4 + 3).y, 1000.0);
+
+	// the sphere mesh has a diameter of 1 and its flat faces sit a little
+	// inside the round sphere, so scale past the range to keep them outside it
+	gl_Position = projection * view * vec4(position + aPos * range * 2.1, 1.0);
+	LightIndex = gl_InstanceID;
+}
@@ -3,18 +3,42 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-instance attributes
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in ivec2 aIndices;	// material, diffuse layer
+layout (location = 8) in mat3 aNormalMatrix;	// computed on the CPU, see computeNormalMatrix()
+
+struct Light {
+	vec3 position;
+	
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	float falloff;
+};
+
+// per-frame camera and light state, shared by every program
+layout (std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	Light light;
+};
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out int MaterialIndex;
+flat out int Layer;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	FragPos = vec3(model * vec4(aPos, 1.0));
-	Normal = mat3(transpose(inverse(model))) * aNormal;
+	gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+	FragPos = vec3(aModel * vec4(aPos, 1.0));
+	Normal = aNormalMatrix * aNormal;
 	TexCoords = aTexCoords;
+	MaterialIndex = aIndices.x;
+	Layer = aIndices.y;
 }
@@ -0,0 +1,96 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file. On POSIX systems the file is memory-mapped,
+// so pages are only read when touched; elsewhere it is read in one go.
+class MappedFile
+{
+public:
+	MappedFile() : address(NULL), length(0) {}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string &path)
+	{
+		close();
+
+#ifndef _WIN32
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+
+		if (mapping == MAP_FAILED)
+			return false;
+
+		address = (const char*)mapping;
+		length = info.st_size;
+#else
+		std::ifstream file(path.c_str(), std::ios::binary);
+		if (!file)
+			return false;
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+		std::string contents = stream.str();
+		if (contents.empty())
+			return false;
+
+		buffer.assign(contents.begin(), contents.end());
+		address = &buffer[0];
+		length = buffer.size();
+#endif
+		return true;
+	}
+
+	void close()
+	{
+#ifndef _WIN32
+		if (address != NULL)
+			munmap((void*)address, length);
+#endif
+		buffer.clear();
+		address = NULL;
+		length = 0;
+	}
+
+	bool isOpen() const { return address != NULL; }
+	const char *data() const { return address; }
+	size_t size() const { return length; }
+
+private:
+	const char *address;
+	size_t length;
+	std::vector<char> buffer;	// file contents where mmap isn't available
+};
+
+#endif
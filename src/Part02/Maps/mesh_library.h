@@ -0,0 +1,429 @@
+#ifndef MESH_LIBRARY_H
+#define MESH_LIBRARY_H
+
+#include <glad/glad.h>
+
+#include <string.h>
+
+#include <map>
+#include <vector>
+#include <iostream>
+
+#include "gl_state.h"
+#include "vertex_format.h"
+
+// Indexed triangles of one primitive, filled in at compile time by generateMesh()
+template <unsigned int V, unsigned int I>
+struct MeshData
+{
+	MeshVertex vertices[V];
+	unsigned short indices[I];
+};
+
+// ---------------------------------------------------------------------------
+// Compile-time helpers. Everything here has to be a single-return constexpr
+// function (C++11), so loops are written as recursion and pack expansions.
+// ---------------------------------------------------------------------------
+
+constexpr double MESH_PI = 3.14159265358979323846;
+
+// Taylor series of sin(x), accurate to float precision for |x| <= pi
+constexpr double meshSinTerms(double x2, double term, unsigned int n)
+{
+	return n > 21 ? term : term + meshSinTerms(x2, -term * x2 / ((n + 1) * (n + 2)), n + 2);
+}
+
+constexpr double meshSin(double x)
+{
+	return x > MESH_PI ? meshSin(x - 2.0 * MESH_PI) : (x < -MESH_PI ? meshSin(x + 2.0 * MESH_PI) : meshSinTerms(x * x, x, 1));
+}
+
+constexpr double meshCos(double x)
+{
+	return meshSin(x + MESH_PI / 2.0);
+}
+
+constexpr MeshVertex meshVertex(double x, double y, double z, double nx, double ny, double nz, double u, double v)
+{
+	return MeshVertex{ { (float)x, (float)y, (float)z }, { (float)nx, (float)ny, (float)nz }, { (float)u, (float)v } };
+}
+
+// 0..N-1 as a parameter pack, built in halves so long lists stay within the template depth limit
+template <unsigned int... N> struct MeshIndexList {};
+
+template <class A, class B> struct MeshConcat;
+template <unsigned int... A, unsigned int... B>
+struct MeshConcat<MeshIndexList<A...>, MeshIndexList<B...> >
+{
+	typedef MeshIndexList<A..., (sizeof...(A) + B)...> type;
+};
+
+template <unsigned int N>
+struct MeshSequence
+{
+	typedef typename MeshConcat<typename MeshSequence<N / 2>::type, typename MeshSequence<N - N / 2>::type>::type type;
+};
+template <> struct MeshSequence<0> { typedef MeshIndexList<> type; };
+template <> struct MeshSequence<1> { typedef MeshIndexList<0> type; };
+
+template <class Shape, unsigned int... Vs, unsigned int... Is>
+constexpr MeshData<Shape::vertexCount, Shape::indexCount> generateMesh(MeshIndexList<Vs...>, MeshIndexList<Is...>)
+{
+	return MeshData<Shape::vertexCount, Shape::indexCount>{ { Shape::vertex(Vs)... }, { Shape::index(Is)... } };
+}
+
+// Evaluates a shape's vertex(i) and index(i) for every i
+template <class Shape>
+constexpr MeshData<Shape::vertexCount, Shape::indexCount> generateMesh()
+{
+	return generateMesh<Shape>(typename MeshSequence<Shape::vertexCount>::type(), typename MeshSequence<Shape::indexCount>::type());
+}
+
+// Two triangles per quad, corners in the order 0 1 2 2 3 0
+constexpr unsigned int quadCorner(unsigned int i)
+{
+	return i % 6 < 3 ? i % 6 : (i % 6 == 5 ? 0 : i % 6 - 1);
+}
+
+// ---------------------------------------------------------------------------
+// Primitives. Each is a unit-sized shape centred on the origin, described by
+// vertexCount, indexCount and the vertex(i) / index(i) that generate it.
+// ---------------------------------------------------------------------------
+
+// Texture rectangle of a cube face: the face's (0,0)-(1,1) square maps to (u0,v0)-(u1,v1)
+struct FaceUV
+{
+	float u0, v0, u1, v1;
+};
+
+// Every face shows the whole image
+struct FullFaceUVs
+{
+	static constexpr FaceUV face(unsigned int) { return FaceUV{ 0.0f, 0.0f, 1.0f, 1.0f }; }
+};
+
+// The front (+z) face shows the top half of the image, the other faces the bottom half upside down
+struct FrontFaceUVs
+{
+	static constexpr FaceUV face(unsigned int f) { return f == 0 ? FaceUV{ 0.0f, 0.5f, 1.0f, 1.0f } : FaceUV{ 0.0f, 0.5f, 1.0f, 0.0f }; }
+};
+
+// Cube with four vertices per face, faces in the order +z -z -x +x -y +y
+template <class UVs>
+struct CubeShape
+{
+	static const unsigned int vertexCount = 24;
+	static const unsigned int indexCount = 36;
+
+	// face-local coordinates of corner c; the x and y faces start at a different corner
+	static constexpr double s(unsigned int f, unsigned int c)
+	{
+		return f == 2 || f == 3 ? (c == 0 || c == 1) : (c == 1 || c == 2);
+	}
+	static constexpr double t(unsigned int f, unsigned int c)
+	{
+		return f < 2 ? (c >= 2) : (f < 4 ? (c == 1 || c == 2) : (c < 2));
+	}
+
+	static constexpr MeshVertex corner(unsigned int f, double s, double t, FaceUV uv)
+	{
+		return f == 0 ? meshVertex(s - 0.5, t - 0.5, 0.5, 0, 0, 1, uv.u0 + s * (uv.u1 - uv.u0), uv.v0 + t * (uv.v1 - uv.v0))
+			: f == 1 ? meshVertex(s - 0.5, t - 0.5, -0.5, 0, 0, -1, uv.u0 + s * (uv.u1 - uv.u0), uv.v0 + t * (uv.v1 - uv.v0))
+			: f == 2 ? meshVertex(-0.5, s - 0.5, 0.5 - t, -1, 0, 0, uv.u0 + s * (uv.u1 - uv.u0), uv.v0 + t * (uv.v1 - uv.v0))
+			: f == 3 ? meshVertex(0.5, s - 0.5, 0.5 - t, 1, 0, 0, uv.u0 + s * (uv.u1 - uv.u0), uv.v0 + t * (uv.v1 - uv.v0))
+			: f == 4 ? meshVertex(s - 0.5, -0.5, 0.5 - t, 0, -1, 0, uv.u0 + s * (uv.u1 - uv.u0), uv.v0 + t * (uv.v1 - uv.v0))
+			: meshVertex(s - 0.5, 0.5, 0.5 - t, 0, 1, 0, uv.u0 + s * (uv.u1 - uv.u0), uv.v0 + t * (uv.v1 - uv.v0));
+	}
+
+	static constexpr MeshVertex vertex(unsigned int i)
+	{
+		return corner(i / 4, s(i / 4, i % 4), t(i / 4, i % 4), UVs::face(i / 4));
+	}
+
+	// the corners of the -z, +x and +y faces run clockwise seen from outside,
+	// so their quads are walked the other way round to wind counter-clockwise
+	static constexpr unsigned int faceCorner(unsigned int f, unsigned int c)
+	{
+		return f % 2 == 1 ? (4 - c) % 4 : c;
+	}
+
+	static constexpr unsigned short index(unsigned int i)
+	{
+		return (unsigned short)(i / 6 * 4 + faceCorner(i / 6, quadCorner(i)));
+	}
+};
+
+// Square in the xz plane facing +y, split into N x N quads
+template <unsigned int N>
+struct PlaneShape
+{
+	static const unsigned int vertexCount = (N + 1) * (N + 1);
+	static const unsigned int indexCount = N * N * 6;
+
+	static constexpr MeshVertex vertex(unsigned int i)
+	{
+		return meshVertex((double)(i % (N + 1)) / N - 0.5, 0.0, 0.5 - (double)(i / (N + 1)) / N, 0, 1, 0, (double)(i % (N + 1)) / N, (double)(i / (N + 1)) / N);
+	}
+
+	// corner c of quad q, counter-clockwise seen from above
+	static constexpr unsigned int quadVertex(unsigned int q, unsigned int c)
+	{
+		return (q / N + (c >= 2)) * (N + 1) + q % N + (c == 1 || c == 2);
+	}
+
+	static constexpr unsigned short index(unsigned int i)
+	{
+		return (unsigned short)quadVertex(i / 6, quadCorner(i));
+	}
+};
+
+// Cylinder along y with S sides: the side's seam column is doubled so its
+// texture wraps once, and each cap is a fan around its own centre
+template <unsigned int S>
+struct CylinderShape
+{
+	static const unsigned int sideVertices = 2 * (S + 1);
+	static const unsigned int capVertices = S + 2;
+	static const unsigned int vertexCount = sideVertices + 2 * capVertices;
+	static const unsigned int indexCount = 12 * S;
+
+	static constexpr double angle(unsigned int k)
+	{
+		return 2.0 * MESH_PI * k / S;
+	}
+
+	static constexpr MeshVertex sideVertex(unsigned int ring, unsigned int k)
+	{
+		return meshVertex(0.5 * meshSin(angle(k)), ring - 0.5, 0.5 * meshCos(angle(k)), meshSin(angle(k)), 0, meshCos(angle(k)), (double)k / S, ring);
+	}
+
+	// vertex 0 of a cap is its centre, 1..S+1 its rim
+	static constexpr MeshVertex capVertex(unsigned int top, unsigned int k)
+	{
+		return k == 0 ? meshVertex(0, top - 0.5, 0, 0, top ? 1 : -1, 0, 0.5, 0.5)
+			: meshVertex(0.5 * meshSin(angle(k - 1)), top - 0.5, 0.5 * meshCos(angle(k - 1)), 0, top ? 1 : -1, 0, 0.5 + 0.5 * meshSin(angle(k - 1)), 0.5 + 0.5 * meshCos(angle(k - 1)));
+	}
+
+	static constexpr MeshVertex vertex(unsigned int i)
+	{
+		return i < sideVertices ? sideVertex(i / (S + 1), i % (S + 1)) : capVertex((i - sideVertices) / capVertices, (i - sideVertices) % capVertices);
+	}
+
+	static constexpr unsigned int sideIndex(unsigned int q, unsigned int c)
+	{
+		return (c >= 2) * (S + 1) + q + (c == 1 || c == 2);
+	}
+
+	// fan triangle j of a cap, wound to face away from the cylinder
+	static constexpr unsigned int capIndex(unsigned int top, unsigned int j, unsigned int c)
+	{
+		return sideVertices + top * capVertices + (c == 0 ? 0 : 1 + j + ((c == 1) == (top == 0)));
+	}
+
+	static constexpr unsigned short index(unsigned int i)
+	{
+		return (unsigned short)(i < 6 * S ? sideIndex(i / 6, quadCorner(i)) : capIndex((i - 6 * S) / (3 * S), (i - 6 * S) % (3 * S) / 3, (i - 6 * S) % 3));
+	}
+};
+
+// UV sphere of diameter 1 with R rings and S segments; the seam column is doubled
+template <unsigned int R, unsigned int S>
+struct SphereShape
+{
+	static const unsigned int vertexCount = (R + 1) * (S + 1);
+	static const unsigned int indexCount = R * S * 6;
+
+	static constexpr MeshVertex point(double phi, double theta, double u, double v)
+	{
+		return meshVertex(0.5 * meshSin(phi) * meshSin(theta), 0.5 * meshCos(phi), 0.5 * meshSin(phi) * meshCos(theta),
+			meshSin(phi) * meshSin(theta), meshCos(phi), meshSin(phi) * meshCos(theta), u, v);
+	}
+
+	static constexpr MeshVertex vertex(unsigned int i)
+	{
+		return point(MESH_PI * (i / (S + 1)) / R, 2.0 * MESH_PI * (i % (S + 1)) / S, (double)(i % (S + 1)) / S, 1.0 - (double)(i / (S + 1)) / R);
+	}
+
+	static constexpr unsigned int quadVertex(unsigned int q, unsigned int c)
+	{
+		return (q / S + (c == 1 || c == 2)) * (S + 1) + q % S + (c >= 2);
+	}
+
+	static constexpr unsigned short index(unsigned int i)
+	{
+		return (unsigned short)quadVertex(i / 6, quadCorner(i));
+	}
+};
+
+// The primitives the programs use, generated by the compiler
+constexpr MeshData<24, 36> CUBE_MESH = generateMesh<CubeShape<FullFaceUVs> >();
+constexpr MeshData<24, 36> FACE_CUBE_MESH = generateMesh<CubeShape<FrontFaceUVs> >();
+constexpr MeshData<PlaneShape<1>::vertexCount, PlaneShape<1>::indexCount> PLANE_MESH = generateMesh<PlaneShape<1> >();
+constexpr MeshData<CylinderShape<24>::vertexCount, CylinderShape<24>::indexCount> CYLINDER_MESH = generateMesh<CylinderShape<24> >();
+constexpr MeshData<SphereShape<12, 24>::vertexCount, SphereShape<12, 24>::indexCount> SPHERE_MESH = generateMesh<SphereShape<12, 24> >();
+
+// ---------------------------------------------------------------------------
+// Pooling
+// ---------------------------------------------------------------------------
+
+// A mesh's range in a MeshPool
+struct Mesh
+{
+	unsigned int VAO;
+	unsigned int indexCount;
+	unsigned int firstIndex;
+	int baseVertex;
+
+	// object-space bounding box of its vertices
+	float boundsMin[3];
+	float boundsMax[3];
+
+	bool operator==(const Mesh &other) const
+	{
+		return VAO == other.VAO && indexCount == other.indexCount && firstIndex == other.firstIndex && baseVertex == other.baseVertex;
+	}
+
+	bool operator!=(const Mesh &other) const
+	{
+		return !(*this == other);
+	}
+
+	// Draws the mesh; its pool's VAO must be bound
+	void draw() const
+	{
+		glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void*)(firstIndex * sizeof(unsigned short)), baseVertex);
+	}
+
+	void drawInstanced(unsigned int instanceCount) const
+	{
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void*)(firstIndex * sizeof(unsigned short)), instanceCount, baseVertex);
+	}
+};
+
+// Keeps every mesh in one vertex buffer and one index buffer behind a single
+// VAO, so switching meshes never rebinds anything: each mesh is just an index
+// range plus a base vertex. Add all meshes, then build() uploads them once,
+// converted to the pool's vertex format.
+class MeshPool
+{
+public:
+	unsigned int VAO, VBO, IBO;
+
+	MeshPool(VertexFormat format = VERTEX_FORMAT_PACKED) : format(format)
+	{
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &IBO);
+	}
+
+	MeshPool(const MeshPool&) = delete;
+	MeshPool& operator=(const MeshPool&) = delete;
+
+	template <unsigned int V, unsigned int I>
+	Mesh add(const MeshData<V, I> &data)
+	{
+		return add(data.vertices, V, data.indices, I);
+	}
+
+	// Appends an indexed mesh; indices are relative to its own first vertex
+	Mesh add(const MeshVertex *meshVertices, unsigned int vertexCount, const unsigned short *meshIndices, unsigned int indexCount)
+	{
+		// indices are 16-bit, but the base vertex lets the pool itself grow past 65536 vertices
+		if (vertexCount > 65536)
+			std::cout << "ERROR::MESH_POOL::TOO_MANY_VERTICES" << std::endl;
+
+		Mesh mesh = { VAO, indexCount, (unsigned int)indices.size(), (int)vertices.size(), { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float p = meshVertices[i].position[axis];
+				if (i == 0 || p < mesh.boundsMin[axis])
+					mesh.boundsMin[axis] = p;
+				if (i == 0 || p > mesh.boundsMax[axis])
+					mesh.boundsMax[axis] = p;
+			}
+		}
+
+		vertices.insert(vertices.end(), meshVertices, meshVertices + vertexCount);
+		indices.insert(indices.end(), meshIndices, meshIndices + indexCount);
+
+		return mesh;
+	}
+
+	// Appends a non-indexed triangle list, merging identical vertices
+	Mesh addTriangles(const MeshVertex *triangleVertices, unsigned int count)
+	{
+		std::map<MeshVertex, unsigned short, VertexLess> unique;
+		std::vector<MeshVertex> meshVertices;
+		std::vector<unsigned short> meshIndices;
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			std::map<MeshVertex, unsigned short, VertexLess>::iterator found = unique.find(triangleVertices[i]);
+			if (found == unique.end())
+			{
+				found = unique.insert(std::make_pair(triangleVertices[i], (unsigned short)meshVertices.size())).first;
+				meshVertices.push_back(triangleVertices[i]);
+			}
+			meshIndices.push_back(found->second);
+		}
+
+		return add(&meshVertices[0], (unsigned int)meshVertices.size(), &meshIndices[0], (unsigned int)meshIndices.size());
+	}
+
+	// Uploads everything added so far and sets up the vertex attributes
+	void build()
+	{
+		glState().bindVertexArray(VAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (format == VERTEX_FORMAT_PACKED)
+		{
+			std::vector<PackedVertex> packed(vertices.size());
+			packVertices(&vertices[0], (unsigned int)vertices.size(), &packed[0]);
+			glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), &packed[0], GL_STATIC_DRAW);
+		}
+		else
+		{
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), &vertices[0], GL_STATIC_DRAW);
+		}
+
+		// the element buffer binding is part of the VAO's state
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+
+		setVertexAttributes(format);
+	}
+
+	unsigned int vertexCount() const
+	{
+		return (unsigned int)vertices.size();
+	}
+
+	unsigned int indexCount() const
+	{
+		return (unsigned int)indices.size();
+	}
+
+	VertexFormat vertexFormat() const
+	{
+		return format;
+	}
+
+private:
+	VertexFormat format;
+	std::vector<MeshVertex> vertices;	// kept in the float layout until build()
+	std::vector<unsigned short> indices;
+
+	struct VertexLess
+	{
+		bool operator()(const MeshVertex &a, const MeshVertex &b) const
+		{
+			return memcmp(&a, &b, sizeof(MeshVertex)) < 0;
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef POINT_SHADOW_H
+#define POINT_SHADOW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+
+#include "gl_state.h"
+
+// Texture unit the lit shaders sample the shadow cube from
+const unsigned int SHADOW_MAP_UNIT = 7;
+
+// Omnidirectional shadow map for a point light, split into two depth cubes.
+// Static casters are drawn into a cached cube only when the light moves or
+// the caller invalidates it (say, when a door comes to rest); every frame
+// that cache is copied into the cube the scene samples and the moving
+// casters are drawn on top. Both passes render all six faces at once
+// through the shadow_depth geometry shader, which stores the distance to
+// the light divided by the far plane as depth. While the light stays put a
+// frame costs six depth blits and the moving casters only.
+class PointShadow
+{
+public:
+	// Static cache and the composited cube the scene samples
+	unsigned int textures[2];
+
+	// Layered framebuffers over each cube, and two for copying single faces
+	unsigned int FBO[4];
+
+	struct Stats
+	{
+		unsigned int staticRedraws;	// times the static cache was redrawn
+	};
+
+	Stats stats;
+
+	PointShadow(unsigned int resolution, float farPlane) : size(0), farDistance(farPlane), valid(false)
+	{
+		stats.staticRedraws = 0;
+
+		glGenTextures(2, textures);
+		glGenFramebuffers(4, FBO);
+
+		// depth-only framebuffers must say so to be complete in GL 3.3
+		for (int i = 2; i < 4; i++)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, FBO[i]);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		setResolution(resolution);
+	}
+
+	PointShadow(const PointShadow&) = delete;
+	PointShadow& operator=(const PointShadow&) = delete;
+
+	// Reallocates both cubes at a new size per face
+	void setResolution(unsigned int resolution)
+	{
+		if (resolution == size)
+			return;
+
+		size = resolution;
+
+		for (int t = 0; t < 2; t++)
+		{
+			glState().bindTexture(GL_TEXTURE_CUBE_MAP, textures[t]);
+			for (int face = 0; face < 6; face++)
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+			// hardware depth comparison with bilinear filtering gives 2x2 PCF for free
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, FBO[t]);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[t], 0);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				std::cout << "ERROR::POINT_SHADOW::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		}
+
+		glState().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		valid = false;
+	}
+
+	unsigned int resolution() const
+	{
+		return size;
+	}
+
+	float farPlane() const
+	{
+		return farDistance;
+	}
+
+	// Forces the static casters to be redrawn by the next update()
+	void invalidate()
+	{
+		valid = false;
+	}
+
+	// Places the light for this frame; returns true when the static cache must
+	// be redrawn, in which case faceMatrices() has changed too
+	bool update(const glm::vec3 &position)
+	{
+		if (valid && position == lightPosition)
+			return false;
+
+		lightPosition = position;
+
+		const glm::vec3 directions[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+		const glm::vec3 ups[6] = { glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, farDistance);
+
+		for (int face = 0; face < 6; face++)
+			matrices[face] = projection * glm::lookAt(position, position + directions[face], ups[face]);
+
+		valid = true;
+		stats.staticRedraws++;
+		return true;
+	}
+
+	const glm::vec3 &position() const
+	{
+		return lightPosition;
+	}
+
+	// View-projection of each cube face, in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+	const glm::mat4 *faceMatrices() const
+	{
+		return matrices;
+	}
+
+	// Targets and clears the static cache
+	void beginStatic()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[0]);
+		glViewport(0, 0, size, size);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	// Copies the static cache into the sampled cube and targets it for the moving casters
+	void beginDynamic()
+	{
+		for (int face = 0; face < 6; face++)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO[2]);
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, textures[0], 0);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO[3]);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, textures[1], 0);
+			glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[1]);
+		glViewport(0, 0, size, size);
+	}
+
+	// Back to the window
+	void end(int width, int height)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+	}
+
+	void bind() const
+	{
+		glState().bindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_CUBE_MAP, textures[1]);
+	}
+
+private:
+	unsigned int size;
+	float farDistance;
+	bool valid;
+	glm::vec3 lightPosition;
+	glm::mat4 matrices[6];
+};
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef PORTALS_H
+#define PORTALS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "frustum.h"
+
+// Rectangle in normalized device coordinates
+struct ScreenRect
+{
+	float minX, minY, maxX, maxY;
+
+	bool empty() const
+	{
+		return minX >= maxX || minY >= maxY;
+	}
+
+	ScreenRect intersect(const ScreenRect &other) const
+	{
+		ScreenRect r = { glm::max(minX, other.minX), glm::max(minY, other.minY), glm::min(maxX, other.maxX), glm::min(maxY, other.maxY) };
+		return r;
+	}
+
+	// Grows to cover other; returns true if that made the rectangle larger
+	bool expand(const ScreenRect &other)
+	{
+		ScreenRect r = { glm::min(minX, other.minX), glm::min(minY, other.minY), glm::max(maxX, other.maxX), glm::max(maxY, other.maxY) };
+		bool grew = r.minX < minX || r.minY < minY || r.maxX > maxX || r.maxY > maxY;
+		*this = r;
+		return grew;
+	}
+};
+
+// Cell-and-portal visibility. Rooms are cells (boxes) and doorways are
+// portals (quads) joining two cells. Starting from the cell that holds the
+// camera, each open portal that shows on screen makes the cell behind it
+// visible, but only through the portal's screen rectangle, which in turn
+// limits what the next portals can show. Cells no chain of open portals
+// reaches are never drawn, however much of the house they hold.
+class PortalVisibility
+{
+public:
+	struct Stats
+	{
+		unsigned int visibleCells;
+		unsigned int portalsTested;	// open portals projected this frame
+		int cameraCell;			// -1 when the camera is outside every cell
+	};
+
+	Stats stats;
+
+	PortalVisibility()
+	{
+		stats.visibleCells = stats.portalsTested = 0;
+		stats.cameraCell = -1;
+	}
+
+	int addCell(const AABB &bounds)
+	{
+		Cell cell;
+		cell.bounds = bounds;
+		cell.visible = false;
+		cells.push_back(cell);
+		return (int)cells.size() - 1;
+	}
+
+	// Joins two cells with a quad; its corners go around its edge
+	int addPortal(int a, int b, const glm::vec3 corners[4])
+	{
+		Portal portal;
+		portal.cells[0] = a;
+		portal.cells[1] = b;
+		for (int i = 0; i < 4; i++)
+			portal.corners[i] = corners[i];
+		portal.open = true;
+
+		portals.push_back(portal);
+		cells[a].portals.push_back((int)portals.size() - 1);
+		cells[b].portals.push_back((int)portals.size() - 1);
+		return (int)portals.size() - 1;
+	}
+
+	void setOpen(int portal, bool open)
+	{
+		portals[portal].open = open;
+	}
+
+	unsigned int cellCount() const
+	{
+		return (unsigned int)cells.size();
+	}
+
+	// Finds the cells visible from eye and the screen area each is seen through
+	void update(const glm::mat4 &viewProjection, const glm::vec3 &eye)
+	{
+		this->viewProjection = viewProjection;
+		stats.visibleCells = stats.portalsTested = 0;
+		stats.cameraCell = -1;
+
+		for (size_t i = 0; i < cells.size(); i++)
+		{
+			cells[i].visible = false;
+			if (stats.cameraCell < 0 && contains(cells[i].bounds, eye))
+				stats.cameraCell = (int)i;
+		}
+
+		ScreenRect screen = { -1.0f, -1.0f, 1.0f, 1.0f };
+
+		// from outside the house there is nothing to clip against, so every cell is a candidate
+		if (stats.cameraCell < 0)
+		{
+			for (size_t i = 0; i < cells.size(); i++)
+				reach((int)i, screen);
+		}
+		else
+		{
+			visit(stats.cameraCell, screen, 0);
+		}
+
+		for (size_t i = 0; i < cells.size(); i++)
+		{
+			if (cells[i].visible)
+			{
+				const ScreenRect &r = cells[i].rect;
+				cells[i].frustum = Frustum(viewProjection, r.minX, r.minY, r.maxX, r.maxY);
+				stats.visibleCells++;
+			}
+		}
+	}
+
+	bool cellVisible(int cell) const
+	{
+		return cells[cell].visible;
+	}
+
+	// Whether a box in the given cell can be seen; -1 means the box belongs to no cell
+	bool visible(int cell, const AABB &bounds) const
+	{
+		if (cell < 0)
+			return true;
+
+		return cells[cell].visible && cells[cell].frustum.test(bounds) != FRUSTUM_OUTSIDE;
+	}
+
+private:
+	// portal chains longer than this are not followed
+	static const int MAX_DEPTH = 16;
+
+	struct Cell
+	{
+		AABB bounds;
+		std::vector<int> portals;
+		bool visible;
+		ScreenRect rect;	// union of the screen areas the cell is seen through
+		Frustum frustum;	// view frustum narrowed to rect
+	};
+
+	struct Portal
+	{
+		int cells[2];
+		glm::vec3 corners[4];
+		bool open;
+	};
+
+	std::vector<Cell> cells;
+	std::vector<Portal> portals;
+	glm::mat4 viewProjection;
+
+	static bool contains(const AABB &box, const glm::vec3 &p)
+	{
+		return p.x >= box.min.x && p.y >= box.min.y && p.z >= box.min.z && p.x <= box.max.x && p.y <= box.max.y && p.z <= box.max.z;
+	}
+
+	// Marks a cell visible through rect; returns false if that adds nothing new
+	bool reach(int cell, const ScreenRect &rect)
+	{
+		Cell &c = cells[cell];
+
+		if (!c.visible)
+		{
+			c.visible = true;
+			c.rect = rect;
+			return true;
+		}
+
+		return c.rect.expand(rect);
+	}
+
+	void visit(int cell, const ScreenRect &rect, int depth)
+	{
+		if (!reach(cell, rect) && depth > 0)
+			return;
+
+		if (depth >= MAX_DEPTH)
+			return;
+
+		for (size_t i = 0; i < cells[cell].portals.size(); i++)
+		{
+			const Portal &portal = portals[cells[cell].portals[i]];
+			if (!portal.open)
+				continue;
+
+			stats.portalsTested++;
+
+			ScreenRect through;
+			if (!project(portal, rect, through))
+				continue;
+
+			visit(portal.cells[0] == cell ? portal.cells[1] : portal.cells[0], through, depth + 1);
+		}
+	}
+
+	// Screen rectangle of a portal clipped to rect; false if none of it shows
+	bool project(const Portal &portal, const ScreenRect &rect, ScreenRect &result) const
+	{
+		const float NEAR_W = 1e-4f;
+
+		ScreenRect bounds = { 1e30f, 1e30f, -1e30f, -1e30f };
+		int behind = 0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			glm::vec4 clip = viewProjection * glm::vec4(portal.corners[i], 1.0f);
+			if (clip.w <= NEAR_W)
+			{
+				behind++;
+				continue;
+			}
+
+			ScreenRect corner = { clip.x / clip.w, clip.y / clip.w, clip.x / clip.w, clip.y / clip.w };
+			bounds.expand(corner);
+		}
+
+		if (behind == 4)
+			return false;
+
+		// a portal crossing the camera plane can cover any part of the screen
+		if (behind > 0)
+			bounds = rect;
+
+		result = bounds.intersect(rect);
+		return !result.empty();
+	}
+};
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Rolling window of timings in milliseconds
+class TimingHistory
+{
+public:
+	TimingHistory(unsigned int length = 300) : samples(length), next(0), count(0) {}
+
+	void add(float ms)
+	{
+		samples[next] = ms;
+		next = (next + 1) % samples.size();
+		if (count < samples.size())
+			count++;
+	}
+
+	bool empty() const { return count == 0; }
+
+	// Writes the minimum, mean and 99th percentile of the window
+	void stats(float &min, float &avg, float &p99) const
+	{
+		std::vector<float> sorted(samples.begin(), samples.begin() + count);
+		std::sort(sorted.begin(), sorted.end());
+
+		float sum = 0.0f;
+		for (size_t i = 0; i < sorted.size(); i++)
+			sum += sorted[i];
+
+		min = sorted.front();
+		avg = sum / sorted.size();
+		p99 = sorted[(sorted.size() - 1) * 99 / 100];
+	}
+
+private:
+	std::vector<float> samples;
+	size_t next, count;
+};
+
+// CPU and GPU timings of named sections of the frame.
+//
+// GPU times come from GL_TIME_ELAPSED queries. Each section owns two queries
+// used on alternate frames, and a query is only read back two frames after it
+// was issued (and only if its result is already available), so reading the
+// results never stalls the pipeline. Elapsed-time queries can't overlap, so
+// sections must not nest and each one runs at most once per frame.
+class Profiler
+{
+public:
+	Profiler(unsigned int historyLength = 300) : historyLength(historyLength), frame(0), frameTime(historyLength)
+	{
+		frameStart = Clock::now();
+	}
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	// Returns the ID of a named section, creating it on first use
+	int section(const std::string &name)
+	{
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			if (sections[i].name == name)
+				return (int)i;
+		}
+
+		Section s;
+		s.name = name;
+		s.cpu = TimingHistory(historyLength);
+		s.gpu = TimingHistory(historyLength);
+		glGenQueries(2, s.queries);
+		s.issued[0] = s.issued[1] = false;
+
+		sections.push_back(s);
+		return (int)sections.size() - 1;
+	}
+
+	// Starts a frame: records the previous frame's length and collects the GPU
+	// results issued two frames ago
+	void beginFrame()
+	{
+		Clock::time_point now = Clock::now();
+		if (frame > 0)
+			frameTime.add(milliseconds(frameStart, now));
+		frameStart = now;
+
+		frame++;
+		unsigned int set = frame % 2;
+
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			Section &s = sections[i];
+			if (!s.issued[set])
+				continue;
+
+			GLint available = 0;
+			glGetQueryObjectiv(s.queries[set], GL_QUERY_RESULT_AVAILABLE, &available);
+
+			// a result that still isn't ready is dropped rather than waited for
+			if (available)
+			{
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(s.queries[set], GL_QUERY_RESULT, &elapsed);
+				s.gpu.add(elapsed / 1000000.0f);
+			}
+
+			s.issued[set] = false;
+		}
+	}
+
+	void begin(int id)
+	{
+		Section &s = sections[id];
+		unsigned int set = frame % 2;
+
+		s.start = Clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, s.queries[set]);
+		s.issued[set] = true;
+	}
+
+	void end(int id)
+	{
+		Section &s = sections[id];
+
+		glEndQuery(GL_TIME_ELAPSED);
+		s.cpu.add(milliseconds(s.start, Clock::now()));
+	}
+
+	// Prints min/avg/p99 of every section over the history window
+	void report(std::ostream &out) const
+	{
+		out << std::fixed << std::setprecision(3);
+		out << "---------------- profile (ms, min / avg / p99) ----------------" << std::endl;
+		out << std::left << std::setw(16) << "section" << std::setw(28) << "cpu" << "gpu" << std::endl;
+
+		for (size_t i = 0; i < sections.size(); i++)
+			printRow(out, sections[i].name, sections[i].cpu, &sections[i].gpu);
+
+		printRow(out, "frame", frameTime, NULL);
+		out << std::right;
+	}
+
+	// Writes min/avg/p99 of every section as a JSON object
+	void writeJSON(std::ostream &out, const std::string &indent = "") const
+	{
+		out << std::fixed << std::setprecision(4) << "{";
+
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			out << (i > 0 ? "," : "") << std::endl << indent << "\t\"" << sections[i].name << "\": { ";
+			out << "\"cpu_ms\": " << json(sections[i].cpu) << ", \"gpu_ms\": " << json(sections[i].gpu) << " }";
+		}
+
+		out << std::endl << indent << "}";
+	}
+
+	// Deletes the queries; call while the context is still current
+	void deleteQueries()
+	{
+		for (size_t i = 0; i < sections.size(); i++)
+			glDeleteQueries(2, sections[i].queries);
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Section
+	{
+		std::string name;
+		TimingHistory cpu;
+		TimingHistory gpu;
+		unsigned int queries[2];
+		bool issued[2];		// query was begun and hasn't been read back yet
+		Clock::time_point start;
+	};
+
+	unsigned int historyLength;
+	unsigned int frame;
+	std::vector<Section> sections;
+
+	TimingHistory frameTime;
+	Clock::time_point frameStart;
+
+	static float milliseconds(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<float, std::milli>(to - from).count();
+	}
+
+	static std::string format(const TimingHistory &history)
+	{
+		if (history.empty())
+			return "-";
+
+		float min, avg, p99;
+		history.stats(min, avg, p99);
+
+		std::ostringstream text;
+		text << std::fixed << std::setprecision(3) << min << " / " << avg << " / " << p99;
+		return text.str();
+	}
+
+	static std::string json(const TimingHistory &history)
+	{
+		if (history.empty())
+			return "null";
+
+		float min, avg, p99;
+		history.stats(min, avg, p99);
+
+		std::ostringstream text;
+		text << std::fixed << std::setprecision(4) << "{ \"min\": " << min << ", \"avg\": " << avg << ", \"p99\": " << p99 << " }";
+		return text.str();
+	}
+
+	static void printRow(std::ostream &out, const std::string &name, const TimingHistory &cpu, const TimingHistory *gpu)
+	{
+		out << std::setw(16) << name << std::setw(28) << format(cpu) << (gpu != NULL ? format(*gpu) : "") << std::endl;
+	}
+};
+
+// Times the enclosing block as one profiler section
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler &profiler, int id) : profiler(profiler), id(id)
+	{
+		profiler.begin(id);
+	}
+
+	~ProfileScope()
+	{
+		profiler.end(id);
+	}
+
+private:
+	Profiler &profiler;
+	int id;
+};
+
+#endif
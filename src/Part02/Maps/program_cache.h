@@ -0,0 +1,223 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#else
+#include <direct.h>
+#endif
+
+#include "gl_extensions.h"
+#include "mapped_file.h"
+
+// ARB_get_program_binary is core only from GL 4.1 and KHR_parallel_shader_compile
+// is an extension, so a 3.3 loader may know neither
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// 64-bit FNV-1a, continued from hash
+inline unsigned long long hashBytes(const void *data, size_t length, unsigned long long hash = 14695981039346656037ull)
+{
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Linked programs saved to disk with glGetProgramBinary, one file per set of
+// sources named by their hash, and loaded back with glProgramBinary so later
+// launches skip compiling. A binary only fits the driver that made it, so
+// each file also records a hash of the vendor, renderer and version strings;
+// after a driver update every file misses once and is rewritten.
+//
+// Also turns on KHR_parallel_shader_compile where the driver has it, so the
+// programs compiled on a miss build side by side (see Shader::finish()).
+class ProgramCache
+{
+public:
+	struct Stats
+	{
+		unsigned int hits;	// programs loaded from disk
+		unsigned int misses;	// programs compiled from source
+	};
+
+	Stats stats;
+
+	ProgramCache(const std::string &directory) : directory(directory), driver(0), getBinary(NULL), loadBinary(NULL), setParameter(NULL), parallel(false)
+	{
+		stats.hits = stats.misses = 0;
+
+		const char *strings[3] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+		driver = hashBytes(NULL, 0);
+		for (int i = 0; i < 3; i++)
+		{
+			if (strings[i])
+				driver = hashBytes(strings[i], strlen(strings[i]) + 1, driver);
+		}
+
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats > 0)
+		{
+			getBinary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+			loadBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+			setParameter = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+		}
+
+		if (hasGLExtension("GL_KHR_parallel_shader_compile") || hasGLExtension("GL_ARB_parallel_shader_compile"))
+		{
+			MaxCompilerThreadsProc maxThreads = (MaxCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+			if (!maxThreads)
+				maxThreads = (MaxCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+
+			// as many threads as the implementation likes
+			if (maxThreads)
+			{
+				maxThreads(0xFFFFFFFFu);
+				parallel = true;
+			}
+		}
+
+#ifndef _WIN32
+		mkdir(directory.c_str(), 0755);
+#else
+		_mkdir(directory.c_str());
+#endif
+	}
+
+	ProgramCache(const ProgramCache&) = delete;
+	ProgramCache& operator=(const ProgramCache&) = delete;
+
+	// Whether binaries can be saved and loaded at all
+	bool enabled() const
+	{
+		return getBinary && loadBinary && setParameter;
+	}
+
+	// Whether the driver compiles programs on threads of its own
+	bool parallelCompile() const
+	{
+		return parallel;
+	}
+
+	// Key of a program built from these sources; empty stages count too
+	unsigned long long key(const std::string &vertex, const std::string &fragment, const std::string &geometry) const
+	{
+		unsigned long long hash = hashBytes(vertex.c_str(), vertex.size() + 1);
+		hash = hashBytes(fragment.c_str(), fragment.size() + 1, hash);
+		return hashBytes(geometry.c_str(), geometry.size() + 1, hash);
+	}
+
+	// Marks a program about to be linked from source as one whose binary will be saved
+	void prepare(unsigned int program)
+	{
+		if (enabled())
+			setParameter(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Loads the saved binary for key into program; false if there is none, or the driver refuses it
+	bool load(unsigned long long sourceKey, unsigned int program)
+	{
+		if (!enabled())
+			return false;
+
+		MappedFile file;
+		if (!file.open(path(sourceKey)))
+			return false;
+
+		Header header;
+		if (file.size() < sizeof(header))
+			return false;
+		memcpy(&header, file.data(), sizeof(header));
+
+		if (header.magic != MAGIC || header.driver != driver || header.source != sourceKey || header.length != file.size() - sizeof(header))
+			return false;
+
+		loadBinary(program, header.format, file.data() + sizeof(header), (GLsizei)header.length);
+
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+			return false;
+
+		stats.hits++;
+		return true;
+	}
+
+	// Saves a program linked from source under key
+	void store(unsigned long long sourceKey, unsigned int program)
+	{
+		stats.misses++;
+		if (!enabled())
+			return;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::string binary(length, '\0');
+		Header header = { MAGIC, 0, driver, sourceKey, (unsigned long long)length };
+		getBinary(program, length, NULL, &header.format, &binary[0]);
+
+		std::ofstream file(path(sourceKey).c_str(), std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), binary.size());
+
+		if (!file)
+			std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << path(sourceKey) << std::endl;
+	}
+
+private:
+	typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+	typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+	typedef void (APIENTRYP MaxCompilerThreadsProc)(GLuint count);
+
+	static const unsigned int MAGIC = 0x4E494250;	// "PBIN"
+
+	struct Header
+	{
+		unsigned int magic;
+		GLenum format;
+		unsigned long long driver;
+		unsigned long long source;
+		unsigned long long length;	// bytes of binary after the header
+	};
+
+	std::string directory;
+	unsigned long long driver;
+	GetProgramBinaryProc getBinary;
+	ProgramBinaryProc loadBinary;
+	ProgramParameteriProc setParameter;
+	bool parallel;
+
+	std::string path(unsigned long long sourceKey) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx.bin", sourceKey);
+		return directory + name;
+	}
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef RENDER_COMMANDS_H
+#define RENDER_COMMANDS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "render_queue.h"
+
+enum RenderCommandType
+{
+	RENDER_USE_PROGRAM,	// handle: program
+	RENDER_SET_MAT4,	// handle: uniform location, data: index into the buffer's mat4s
+	RENDER_SET_VEC3,	// handle: uniform location, data: index into its vec4s, w unused
+	RENDER_SET_VEC4,	// handle: uniform location, data: index into its vec4s
+	RENDER_DRAW		// handle: mesh, texture: diffuse texture, data: index into its draws
+};
+
+// One recorded command. Handles name programs, uniforms, meshes and
+// textures however the backend replaying them does; bulky arguments sit in
+// the recording buffer's arrays and are referred to by index.
+struct RenderCommand
+{
+	unsigned long long key;	// replay order, lowest first; see stateKey() and drawKey()
+	unsigned int type;
+	unsigned int handle;
+	unsigned int texture;
+	unsigned int data;
+};
+
+// Per-object arguments of a draw
+struct RenderDraw
+{
+	glm::mat4 model;
+	glm::mat3 normal;
+	int material;
+	int layer;
+};
+
+// Commands recorded by one thread, with no knowledge of the API that will
+// draw them, so it can be filled on any thread. Each worker records into a
+// buffer of its own and sorts it; the thread owning the context then
+// replays the buffers merged by key (see CommandReplay).
+class CommandBuffer
+{
+public:
+	void clear()
+	{
+		commandList.clear();
+		mat4List.clear();
+		vec4List.clear();
+		drawList.clear();
+	}
+
+	void useProgram(unsigned long long key, unsigned int program)
+	{
+		push(key, RENDER_USE_PROGRAM, program, 0, 0);
+	}
+
+	void setMat4(unsigned long long key, int location, const glm::mat4 &value)
+	{
+		push(key, RENDER_SET_MAT4, (unsigned int)location, 0, (unsigned int)mat4List.size());
+		mat4List.push_back(value);
+	}
+
+	void setVec3(unsigned long long key, int location, const glm::vec3 &value)
+	{
+		push(key, RENDER_SET_VEC3, (unsigned int)location, 0, (unsigned int)vec4List.size());
+		vec4List.push_back(glm::vec4(value, 0.0f));
+	}
+
+	void setVec4(unsigned long long key, int location, const glm::vec4 &value)
+	{
+		push(key, RENDER_SET_VEC4, (unsigned int)location, 0, (unsigned int)vec4List.size());
+		vec4List.push_back(value);
+	}
+
+	void draw(unsigned long long key, unsigned int mesh, unsigned int texture, const glm::mat4 &model, const glm::mat3 &normal, int material, int layer)
+	{
+		push(key, RENDER_DRAW, mesh, texture, (unsigned int)drawList.size());
+		RenderDraw d = { model, normal, material, layer };
+		drawList.push_back(d);
+	}
+
+	// Orders the commands by key; commands with equal keys keep their recording order
+	void sort()
+	{
+		radixSortByKey(commandList, scratch);
+	}
+
+	const std::vector<RenderCommand> &commands() const
+	{
+		return commandList;
+	}
+
+	const glm::mat4 &mat4(unsigned int index) const
+	{
+		return mat4List[index];
+	}
+
+	const glm::vec4 &vec4(unsigned int index) const
+	{
+		return vec4List[index];
+	}
+
+	const RenderDraw &drawData(unsigned int index) const
+	{
+		return drawList[index];
+	}
+
+private:
+	std::vector<RenderCommand> commandList;
+	std::vector<glm::mat4> mat4List;
+	std::vector<glm::vec4> vec4List;
+	std::vector<RenderDraw> drawList;
+	std::vector<RenderCommand> scratch;	// for sort()
+
+	void push(unsigned long long key, unsigned int type, unsigned int handle, unsigned int texture, unsigned int data)
+	{
+		RenderCommand command = { key, type, handle, texture, data };
+		commandList.push_back(command);
+	}
+};
+
+#endif
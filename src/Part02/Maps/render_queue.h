@@ -0,0 +1,132 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stddef.h>
+
+#include <vector>
+
+// Sort keys are 64 bits, most significant field first:
+//
+//	pass		8	passes run in order
+//	program		8	small number naming the program within its pass
+//	draw		1	0 for the commands setting the program up, 1 for its draws
+//	texture		11	diffuse texture
+//	mesh		12
+//	material	8
+//	depth		16	distance from the viewer, nearest first
+//
+// Sorting by it groups draws by what is costliest to switch, so programs
+// and textures change as rarely as possible and draws of one mesh end up
+// next to each other, where they can be instanced. Within a group opaque
+// surfaces go front to back, so the nearest fill the depth buffer first
+// and hide what is behind them before it is shaded. Texture, mesh and
+// material are masked to their width, which only costs sort quality; the
+// program number must be unique within the pass, or draws would sort
+// under another program's setup.
+const float RENDER_KEY_DEPTH_STEPS = 65535.0f;
+
+// Key of a command setting up a program (the switch itself, uniforms); it
+// runs before the program's draws, in sequence order
+inline unsigned long long stateKey(unsigned int pass, unsigned int program, unsigned long long sequence)
+{
+	return ((unsigned long long)(pass & 0xFF) << 56) | ((unsigned long long)(program & 0xFF) << 48) | (sequence & 0x7FFFFFFFFFFFull);
+}
+
+// Key of a draw; depth is the distance from the viewer over the far plane distance
+inline unsigned long long drawKey(unsigned int pass, unsigned int program, unsigned int texture, unsigned int mesh, unsigned int material, float depth)
+{
+	depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+
+	return ((unsigned long long)(pass & 0xFF) << 56) | ((unsigned long long)(program & 0xFF) << 48) | (1ull << 47) |
+		((unsigned long long)(texture & 0x7FF) << 36) | ((unsigned long long)(mesh & 0xFFF) << 24) |
+		((unsigned long long)(material & 0xFF) << 16) | (unsigned long long)(depth * RENDER_KEY_DEPTH_STEPS);
+}
+
+// Sorts items by their key member, lowest first; items with equal keys keep
+// their order. Least significant byte first radix sort: one read of the
+// items counts all eight digits, and a byte every key shares (the pass and
+// program, mostly) costs no pass at all. scratch is reused between calls.
+template <class T>
+void radixSortByKey(std::vector<T> &items, std::vector<T> &scratch)
+{
+	size_t count = items.size();
+	if (count < 2)
+		return;
+
+	size_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int b = 0; b < 8; b++)
+			histograms[b][(items[i].key >> (b * 8)) & 0xFF]++;
+	}
+
+	scratch.resize(count);
+	std::vector<T> *from = &items, *to = &scratch;
+
+	for (int b = 0; b < 8; b++)
+	{
+		size_t *histogram = histograms[b];
+		if (histogram[(items[0].key >> (b * 8)) & 0xFF] == count)
+			continue;
+
+		// counts to the first slot of each digit
+		size_t offset = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			size_t digitCount = histogram[d];
+			histogram[d] = offset;
+			offset += digitCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const T &item = (*from)[i];
+			(*to)[histogram[(item.key >> (b * 8)) & 0xFF]++] = item;
+		}
+
+		std::vector<T> *swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != &items)
+		items.swap(scratch);
+}
+
+struct RenderQueueEntry
+{
+	unsigned long long key;
+	unsigned int item;	// what to draw, in whatever numbering the caller uses
+};
+
+// One frame's draws, queued in any order and issued in key order
+class RenderQueue
+{
+public:
+	void clear()
+	{
+		entryList.clear();
+	}
+
+	void push(unsigned long long key, unsigned int item)
+	{
+		RenderQueueEntry entry = { key, item };
+		entryList.push_back(entry);
+	}
+
+	void sort()
+	{
+		radixSortByKey(entryList, scratch);
+	}
+
+	const std::vector<RenderQueueEntry> &entries() const
+	{
+		return entryList;
+	}
+
+private:
+	std::vector<RenderQueueEntry> entryList;
+	std::vector<RenderQueueEntry> scratch;
+};
+
+#endif
@@ -0,0 +1,707 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "mapped_file.h"
+
+// Text scene description, one statement per line ('#' starts a comment):
+//
+//	texture  <name> <path>
+//	material <name> ambient <r g b> specular <r g b> shininess <s>
+//	light    <name> position <x y z> diffuse <r g b> [specular <r g b>] [falloff <f> | attenuation <constant linear quadratic>]
+//	cell     <name> min <x y z> max <x y z>
+//	portal   <name> cells <cell> <cell> corners <x y z> <x y z> <x y z> <x y z> [door <hook>]
+//	node     <name> [parent <node>] [mesh <cube|face|plane|cylinder|sphere>] [texture <name>] [material <name>]
+//	                [position <x y z>] [rotate <degrees> <x y z>]... [scale <x y z>] [anim <hook>] [cell <name>]
+//
+// Lights are point lights for clustered shading; without a specular colour
+// they use the diffuse one, and without falloff or attenuation they fade out
+// over about 7 units. There are at most SCENE_MAX_MATERIALS materials, and
+// nodes without one use the first. Cells are rooms for portal visibility and portals the doorways between
+// them; a portal with a door is open only while the door hook's node is.
+// Nodes with a mesh need a texture. Nodes outside every cell are always considered. Names must be declared
+// before they are used, so nodes come after their parent and their cell. The text is compiled into a
+// versioned binary cache next to it, which later runs map straight into
+// memory instead of parsing.
+
+const uint32_t SCENE_CACHE_VERSION = 3;
+const int SCENE_NAME_LENGTH = 32;
+const int SCENE_PATH_LENGTH = 128;
+const unsigned int SCENE_MAX_MATERIALS = 8;	// MAX_MATERIALS in flatlighting.fs and gbuffer.fs
+
+// Meshes a node can be drawn with
+enum SceneMesh
+{
+	SCENE_MESH_NONE,
+	SCENE_MESH_CUBE,
+	SCENE_MESH_FACE,
+	SCENE_MESH_PLANE,
+	SCENE_MESH_CYLINDER,
+	SCENE_MESH_SPHERE,
+	SCENE_MESH_COUNT
+};
+
+struct SceneTextureRecord
+{
+	char name[SCENE_NAME_LENGTH];
+	char path[SCENE_PATH_LENGTH];
+};
+
+struct SceneMaterialRecord
+{
+	char name[SCENE_NAME_LENGTH];
+	float ambient[3];
+	float specular[3];
+	float shininess;
+};
+
+struct SceneNodeRecord
+{
+	char name[SCENE_NAME_LENGTH];
+	char anim[SCENE_NAME_LENGTH];	// animation hook the program drives, empty for static nodes
+	int32_t parent;			// index of an earlier node, or -1
+	int32_t mesh;			// SceneMesh
+	int32_t texture;		// index into the texture records, or -1
+	int32_t material;		// index into the material records
+	float position[3];
+	float rotation[4];		// quaternion, w x y z
+	float scale[3];
+	int32_t cell;			// index into the cell records, or -1
+};
+
+struct SceneLightRecord
+{
+	char name[SCENE_NAME_LENGTH];
+	float position[3];
+	float diffuse[3];
+	float specular[3];
+	float falloff;			// falloff / distance^2 when above 0
+	float attenuation[3];		// otherwise 1 / (constant + linear * d + quadratic * d^2)
+};
+
+struct SceneCellRecord
+{
+	char name[SCENE_NAME_LENGTH];
+	float min[3];
+	float max[3];
+};
+
+struct ScenePortalRecord
+{
+	char name[SCENE_NAME_LENGTH];
+	char door[SCENE_NAME_LENGTH];	// animation hook of the door closing it, empty if always open
+	int32_t cells[2];		// indices into the cell records
+	float corners[4][3];		// in order around the edge
+};
+
+struct SceneCacheHeader
+{
+	char magic[4];			// "GHSC"
+	uint32_t version;
+	uint64_t sourceHash;		// hash of the text the cache was compiled from
+	uint32_t textureCount;
+	uint32_t materialCount;
+	uint32_t nodeCount;
+	uint32_t cellCount;
+	uint32_t portalCount;
+	uint32_t lightCount;
+	uint32_t textureOffset;
+	uint32_t materialOffset;
+	uint32_t nodeOffset;
+	uint32_t cellOffset;
+	uint32_t portalOffset;
+	uint32_t lightOffset;
+};
+
+class SceneFile
+{
+public:
+	SceneFile() : data(NULL) {}
+
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+
+	// Loads a scene, using the binary cache when it matches the text and
+	// recompiling (and rewriting the cache) when it does not
+	bool load(const std::string &scenePath)
+	{
+		std::string cachePath = scenePath + ".bin";
+
+		// the text is only hashed here, not parsed
+		std::string source;
+		bool haveSource = readFile(scenePath, source);
+		uint64_t sourceHash = haveSource ? hash(source) : 0;
+
+		if (mapCache(cachePath) && (!haveSource || header().sourceHash == sourceHash))
+			return true;
+
+		unmap();
+
+		if (!haveSource)
+		{
+			std::cout << "ERROR::SCENE::FILE_NOT_SUCCESSFULLY_READ\n" << scenePath << std::endl;
+			return false;
+		}
+
+		if (!compile(source, sourceHash))
+			return false;
+
+		// the cache is only an optimisation, so failing to write it is not an error
+		std::ofstream cacheFile(cachePath.c_str(), std::ios::binary | std::ios::trunc);
+		if (cacheFile)
+			cacheFile.write(&buffer[0], buffer.size());
+		else
+			std::cout << "WARNING::SCENE::CACHE_NOT_WRITTEN\n" << cachePath << std::endl;
+
+		data = &buffer[0];
+		return true;
+	}
+
+	const SceneCacheHeader &header() const
+	{
+		return *(const SceneCacheHeader*)data;
+	}
+
+	unsigned int textureCount() const { return header().textureCount; }
+	unsigned int materialCount() const { return header().materialCount; }
+	unsigned int nodeCount() const { return header().nodeCount; }
+	unsigned int cellCount() const { return header().cellCount; }
+	unsigned int portalCount() const { return header().portalCount; }
+	unsigned int lightCount() const { return header().lightCount; }
+
+	const SceneTextureRecord &texture(unsigned int i) const
+	{
+		return ((const SceneTextureRecord*)(data + header().textureOffset))[i];
+	}
+
+	const SceneMaterialRecord &material(unsigned int i) const
+	{
+		return ((const SceneMaterialRecord*)(data + header().materialOffset))[i];
+	}
+
+	const SceneNodeRecord &node(unsigned int i) const
+	{
+		return ((const SceneNodeRecord*)(data + header().nodeOffset))[i];
+	}
+
+	const SceneCellRecord &cell(unsigned int i) const
+	{
+		return ((const SceneCellRecord*)(data + header().cellOffset))[i];
+	}
+
+	const ScenePortalRecord &portal(unsigned int i) const
+	{
+		return ((const ScenePortalRecord*)(data + header().portalOffset))[i];
+	}
+
+	const SceneLightRecord &light(unsigned int i) const
+	{
+		return ((const SceneLightRecord*)(data + header().lightOffset))[i];
+	}
+
+	// Returns the index of the node with the given animation hook, or -1
+	int findAnimated(const char *hook) const
+	{
+		for (unsigned int i = 0; i < nodeCount(); i++)
+		{
+			if (strncmp(node(i).anim, hook, SCENE_NAME_LENGTH) == 0)
+				return (int)i;
+		}
+
+		std::cout << "ERROR::SCENE::ANIMATION_HOOK_NOT_FOUND " << hook << std::endl;
+		return -1;
+	}
+
+private:
+	const char *data;		// start of the cache image, either mapped or in buffer
+	std::vector<char> buffer;	// cache image built by compile()
+	MappedFile cache;
+
+	static bool readFile(const std::string &path, std::string &contents)
+	{
+		std::ifstream file(path.c_str(), std::ios::binary);
+		if (!file)
+			return false;
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+
+	// 64-bit FNV-1a
+	static uint64_t hash(const std::string &text)
+	{
+		uint64_t h = 14695981039346656037ULL;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			h ^= (unsigned char)text[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	// Maps the cache file read-only and checks it can be used as it is; the
+	// file is only trusted as far as it was written by compile(), so a stale
+	// or damaged one is caught here and rebuilt from the text
+	bool mapCache(const std::string &cachePath)
+	{
+		if (!cache.open(cachePath) || cache.size() < sizeof(SceneCacheHeader))
+			return false;
+
+		data = cache.data();
+
+		const SceneCacheHeader &h = header();
+		if (memcmp(h.magic, "GHSC", 4) != 0 || h.version != SCENE_CACHE_VERSION)
+			return false;
+
+		if (!validCache())
+		{
+			std::cout << "WARNING::SCENE::CACHE_INVALID, rebuilding\n" << cachePath << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Whether every section lies inside the mapped file and every index and name in it is in range
+	bool validCache() const
+	{
+		const SceneCacheHeader &h = header();
+
+		if (h.materialCount > SCENE_MAX_MATERIALS)
+			return false;
+
+		if (!validSection(h.textureOffset, h.textureCount, sizeof(SceneTextureRecord)) ||
+			!validSection(h.materialOffset, h.materialCount, sizeof(SceneMaterialRecord)) ||
+			!validSection(h.nodeOffset, h.nodeCount, sizeof(SceneNodeRecord)) ||
+			!validSection(h.cellOffset, h.cellCount, sizeof(SceneCellRecord)) ||
+			!validSection(h.portalOffset, h.portalCount, sizeof(ScenePortalRecord)) ||
+			!validSection(h.lightOffset, h.lightCount, sizeof(SceneLightRecord)))
+			return false;
+
+		for (unsigned int i = 0; i < textureCount(); i++)
+		{
+			if (!terminated(texture(i).name, SCENE_NAME_LENGTH) || !terminated(texture(i).path, SCENE_PATH_LENGTH))
+				return false;
+		}
+
+		for (unsigned int i = 0; i < nodeCount(); i++)
+		{
+			const SceneNodeRecord &record = node(i);
+
+			// parents come before their children, so the scene graph can be built in one pass
+			if (record.parent < -1 || record.parent >= (int32_t)i)
+				return false;
+			if (record.mesh < SCENE_MESH_NONE || record.mesh >= SCENE_MESH_COUNT)
+				return false;
+			if (record.mesh != SCENE_MESH_NONE && (record.texture < 0 || record.texture >= (int32_t)textureCount()))
+				return false;
+			if (record.texture < -1 || record.texture >= (int32_t)textureCount())
+				return false;
+			if (record.material < 0 || record.material >= (int32_t)materialCount())
+				return false;
+			if (record.cell < -1 || record.cell >= (int32_t)cellCount())
+				return false;
+			if (!terminated(record.name, SCENE_NAME_LENGTH) || !terminated(record.anim, SCENE_NAME_LENGTH))
+				return false;
+		}
+
+		for (unsigned int i = 0; i < portalCount(); i++)
+		{
+			const ScenePortalRecord &record = portal(i);
+
+			for (int c = 0; c < 2; c++)
+			{
+				if (record.cells[c] < 0 || record.cells[c] >= (int32_t)cellCount())
+					return false;
+			}
+			if (!terminated(record.name, SCENE_NAME_LENGTH) || !terminated(record.door, SCENE_NAME_LENGTH))
+				return false;
+		}
+
+		return true;
+	}
+
+	// Whether count records of size bytes at offset fit in the mapped file, aligned for their fields
+	bool validSection(uint32_t offset, uint32_t count, size_t size) const
+	{
+		uint64_t end = (uint64_t)offset + (uint64_t)count * size;
+		return offset >= sizeof(SceneCacheHeader) && offset % 4 == 0 && end <= cache.size();
+	}
+
+	static bool terminated(const char *text, size_t length)
+	{
+		return memchr(text, '\0', length) != NULL;
+	}
+
+	void unmap()
+	{
+		cache.close();
+		buffer.clear();
+		data = NULL;
+	}
+
+	template <typename Record>
+	static int findByName(const std::vector<Record> &records, const std::string &name)
+	{
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			if (name == records[i].name)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	// Copies src with its terminating NUL, reporting it as too long if it does not fit
+	static bool copyName(char *dest, const std::string &src, size_t length, int lineNumber)
+	{
+		if (src.size() >= length)
+			return parseError(lineNumber, src + " is longer than " + std::to_string(length - 1) + " characters");
+
+		memcpy(dest, src.c_str(), src.size() + 1);
+		return true;
+	}
+
+	// Parses the text description into a cache image in buffer
+	bool compile(const std::string &source, uint64_t sourceHash)
+	{
+		std::vector<SceneTextureRecord> textures;
+		std::vector<SceneMaterialRecord> materials;
+		std::vector<SceneNodeRecord> nodes;
+		std::vector<SceneCellRecord> cells;
+		std::vector<ScenePortalRecord> portals;
+		std::vector<SceneLightRecord> lights;
+
+		std::istringstream lines(source);
+		std::string line;
+		int lineNumber = 0;
+
+		while (std::getline(lines, line))
+		{
+			lineNumber++;
+
+			size_t comment = line.find('#');
+			if (comment != std::string::npos)
+				line = line.substr(0, comment);
+
+			std::istringstream tokens(line);
+			std::string keyword, name;
+
+			if (!(tokens >> keyword))
+				continue;
+
+			if (!(tokens >> name))
+				return parseError(lineNumber, "missing name");
+
+			if (keyword == "texture")
+			{
+				SceneTextureRecord record = {};
+				std::string path;
+
+				if (!(tokens >> path))
+					return parseError(lineNumber, "missing texture path");
+
+				if (!copyName(record.name, name, SCENE_NAME_LENGTH, lineNumber))
+					return false;
+				if (!copyName(record.path, path, SCENE_PATH_LENGTH, lineNumber))
+					return false;
+				textures.push_back(record);
+			}
+			else if (keyword == "material")
+			{
+				SceneMaterialRecord record = {};
+				if (!copyName(record.name, name, SCENE_NAME_LENGTH, lineNumber))
+					return false;
+
+				std::string key;
+				while (tokens >> key)
+				{
+					bool ok;
+					if (key == "ambient")
+						ok = (bool)(tokens >> record.ambient[0] >> record.ambient[1] >> record.ambient[2]);
+					else if (key == "specular")
+						ok = (bool)(tokens >> record.specular[0] >> record.specular[1] >> record.specular[2]);
+					else if (key == "shininess")
+						ok = (bool)(tokens >> record.shininess);
+					else
+						return parseError(lineNumber, "unknown material property " + key);
+
+					if (!ok)
+						return parseError(lineNumber, "bad value for " + key);
+				}
+
+				if (materials.size() == SCENE_MAX_MATERIALS)
+					return parseError(lineNumber, "more than " + std::to_string(SCENE_MAX_MATERIALS) + " materials");
+
+				materials.push_back(record);
+			}
+			else if (keyword == "light")
+			{
+				SceneLightRecord record = {};
+				if (!copyName(record.name, name, SCENE_NAME_LENGTH, lineNumber))
+					return false;
+				record.attenuation[0] = 1.0f;
+				record.attenuation[1] = 0.7f;
+				record.attenuation[2] = 1.8f;
+				bool haveSpecular = false;
+
+				std::string key;
+				while (tokens >> key)
+				{
+					bool ok;
+					if (key == "position")
+						ok = (bool)(tokens >> record.position[0] >> record.position[1] >> record.position[2]);
+					else if (key == "diffuse")
+						ok = (bool)(tokens >> record.diffuse[0] >> record.diffuse[1] >> record.diffuse[2]);
+					else if (key == "specular")
+						ok = haveSpecular = (bool)(tokens >> record.specular[0] >> record.specular[1] >> record.specular[2]);
+					else if (key == "falloff")
+						ok = (bool)(tokens >> record.falloff);
+					else if (key == "attenuation")
+						ok = (bool)(tokens >> record.attenuation[0] >> record.attenuation[1] >> record.attenuation[2]);
+					else
+						return parseError(lineNumber, "unknown light property " + key);
+
+					if (!ok)
+						return parseError(lineNumber, "bad value for " + key);
+				}
+
+				if (!haveSpecular)
+					memcpy(record.specular, record.diffuse, sizeof(record.specular));
+
+				lights.push_back(record);
+			}
+			else if (keyword == "cell")
+			{
+				SceneCellRecord record = {};
+				if (!copyName(record.name, name, SCENE_NAME_LENGTH, lineNumber))
+					return false;
+
+				std::string minKey, maxKey;
+				if (!(tokens >> minKey >> record.min[0] >> record.min[1] >> record.min[2] >> maxKey >> record.max[0] >> record.max[1] >> record.max[2]) || minKey != "min" || maxKey != "max")
+					return parseError(lineNumber, "cell needs min <x y z> max <x y z>");
+
+				cells.push_back(record);
+			}
+			else if (keyword == "portal")
+			{
+				ScenePortalRecord record = {};
+				if (!copyName(record.name, name, SCENE_NAME_LENGTH, lineNumber))
+					return false;
+				record.cells[0] = record.cells[1] = -1;
+				bool haveCorners = false;
+
+				std::string key;
+				while (tokens >> key)
+				{
+					bool ok = true;
+
+					if (key == "cells")
+					{
+						for (int i = 0; i < 2 && ok; i++)
+						{
+							std::string value;
+							ok = (bool)(tokens >> value);
+							record.cells[i] = findByName(cells, value);
+							if (ok && record.cells[i] < 0)
+								return parseError(lineNumber, "unknown cell " + value);
+						}
+					}
+					else if (key == "corners")
+					{
+						for (int i = 0; i < 4 && ok; i++)
+							ok = (bool)(tokens >> record.corners[i][0] >> record.corners[i][1] >> record.corners[i][2]);
+						haveCorners = true;
+					}
+					else if (key == "door")
+					{
+						std::string value;
+						ok = (bool)(tokens >> value);
+						if (!copyName(record.door, value, SCENE_NAME_LENGTH, lineNumber))
+							return false;
+					}
+					else
+					{
+						return parseError(lineNumber, "unknown portal property " + key);
+					}
+
+					if (!ok)
+						return parseError(lineNumber, "bad value for " + key);
+				}
+
+				if (record.cells[0] < 0 || !haveCorners)
+					return parseError(lineNumber, "portal needs cells and corners");
+
+				portals.push_back(record);
+			}
+			else if (keyword == "node")
+			{
+				SceneNodeRecord record = {};
+				if (!copyName(record.name, name, SCENE_NAME_LENGTH, lineNumber))
+					return false;
+				record.parent = -1;
+				record.mesh = SCENE_MESH_NONE;
+				record.texture = -1;
+				record.material = 0;
+				record.cell = -1;
+				record.scale[0] = record.scale[1] = record.scale[2] = 1.0f;
+
+				glm::quat rotation;
+
+				std::string key;
+				while (tokens >> key)
+				{
+					std::string value;
+					bool ok = true;
+
+					if (key == "parent")
+					{
+						ok = (bool)(tokens >> value);
+						record.parent = findByName(nodes, value);
+						if (ok && record.parent < 0)
+							return parseError(lineNumber, "parent " + value + " is not declared before this node");
+					}
+					else if (key == "mesh")
+					{
+						ok = (bool)(tokens >> value);
+						if (value == "cube")
+							record.mesh = SCENE_MESH_CUBE;
+						else if (value == "face")
+							record.mesh = SCENE_MESH_FACE;
+						else if (value == "plane")
+							record.mesh = SCENE_MESH_PLANE;
+						else if (value == "cylinder")
+							record.mesh = SCENE_MESH_CYLINDER;
+						else if (value == "sphere")
+							record.mesh = SCENE_MESH_SPHERE;
+						else
+							return parseError(lineNumber, "unknown mesh " + value);
+					}
+					else if (key == "texture")
+					{
+						ok = (bool)(tokens >> value);
+						record.texture = findByName(textures, value);
+						if (ok && record.texture < 0)
+							return parseError(lineNumber, "unknown texture " + value);
+					}
+					else if (key == "material")
+					{
+						ok = (bool)(tokens >> value);
+						record.material = findByName(materials, value);
+						if (ok && record.material < 0)
+							return parseError(lineNumber, "unknown material " + value);
+					}
+					else if (key == "position")
+					{
+						ok = (bool)(tokens >> record.position[0] >> record.position[1] >> record.position[2]);
+					}
+					else if (key == "rotate")
+					{
+						// rotations apply in the order written, like chained glm::rotate calls
+						float degrees;
+						glm::vec3 axis;
+						ok = (bool)(tokens >> degrees >> axis.x >> axis.y >> axis.z);
+						rotation = rotation * glm::angleAxis(glm::radians(degrees), glm::normalize(axis));
+					}
+					else if (key == "scale")
+					{
+						ok = (bool)(tokens >> record.scale[0] >> record.scale[1] >> record.scale[2]);
+					}
+					else if (key == "anim")
+					{
+						ok = (bool)(tokens >> value);
+						if (!copyName(record.anim, value, SCENE_NAME_LENGTH, lineNumber))
+							return false;
+					}
+					else if (key == "cell")
+					{
+						ok = (bool)(tokens >> value);
+						record.cell = findByName(cells, value);
+						if (ok && record.cell < 0)
+							return parseError(lineNumber, "unknown cell " + value);
+					}
+					else
+					{
+						return parseError(lineNumber, "unknown node property " + key);
+					}
+
+					if (!ok)
+						return parseError(lineNumber, "bad value for " + key);
+				}
+
+				// drawn nodes look up their texture by it
+				if (record.mesh != SCENE_MESH_NONE && record.texture < 0)
+					return parseError(lineNumber, "node with a mesh needs a texture");
+				if (record.material >= (int)materials.size())
+					return parseError(lineNumber, "no material is declared before this node");
+
+				record.rotation[0] = rotation.w;
+				record.rotation[1] = rotation.x;
+				record.rotation[2] = rotation.y;
+				record.rotation[3] = rotation.z;
+
+				nodes.push_back(record);
+			}
+			else
+			{
+				return parseError(lineNumber, "unknown statement " + keyword);
+			}
+		}
+
+		// lay out the image: header, then each record array
+		SceneCacheHeader h = {};
+		memcpy(h.magic, "GHSC", 4);
+		h.version = SCENE_CACHE_VERSION;
+		h.sourceHash = sourceHash;
+		h.textureCount = (uint32_t)textures.size();
+		h.materialCount = (uint32_t)materials.size();
+		h.nodeCount = (uint32_t)nodes.size();
+		h.cellCount = (uint32_t)cells.size();
+		h.portalCount = (uint32_t)portals.size();
+		h.lightCount = (uint32_t)lights.size();
+		h.textureOffset = sizeof(SceneCacheHeader);
+		h.materialOffset = h.textureOffset + h.textureCount * sizeof(SceneTextureRecord);
+		h.nodeOffset = h.materialOffset + h.materialCount * sizeof(SceneMaterialRecord);
+		h.cellOffset = h.nodeOffset + h.nodeCount * sizeof(SceneNodeRecord);
+		h.portalOffset = h.cellOffset + h.cellCount * sizeof(SceneCellRecord);
+
+		h.lightOffset = h.portalOffset + h.portalCount * sizeof(ScenePortalRecord);
+
+		buffer.assign(h.lightOffset + h.lightCount * sizeof(SceneLightRecord), 0);
+		memcpy(&buffer[0], &h, sizeof(h));
+		if (!textures.empty())
+			memcpy(&buffer[h.textureOffset], &textures[0], textures.size() * sizeof(SceneTextureRecord));
+		if (!materials.empty())
+			memcpy(&buffer[h.materialOffset], &materials[0], materials.size() * sizeof(SceneMaterialRecord));
+		if (!nodes.empty())
+			memcpy(&buffer[h.nodeOffset], &nodes[0], nodes.size() * sizeof(SceneNodeRecord));
+		if (!cells.empty())
+			memcpy(&buffer[h.cellOffset], &cells[0], cells.size() * sizeof(SceneCellRecord));
+		if (!portals.empty())
+			memcpy(&buffer[h.portalOffset], &portals[0], portals.size() * sizeof(ScenePortalRecord));
+		if (!lights.empty())
+			memcpy(&buffer[h.lightOffset], &lights[0], lights.size() * sizeof(SceneLightRecord));
+
+		return true;
+	}
+
+	static bool parseError(int lineNumber, const std::string &message)
+	{
+		std::cout << "ERROR::SCENE::PARSE_FAILED line " << lineNumber << ": " << message << std::endl;
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+#include "instancing.h"
+
+// A transform in the scene, optionally with a mesh to draw
+struct SceneNode
+{
+	int parent;	// -1 for root nodes; always lower than the node's own index
+
+	// Local transform, applied as translate * rotate * scale
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+
+	// Drawable data; a mesh without indices means the node only carries a transform
+	Mesh mesh;
+	unsigned int texture;
+
+	bool dirty;	// local transform changed since the last update()
+	bool moved;	// world matrix was recomputed by the last update()
+	bool uniform;	// world transform is rigid or uniformly scaled
+};
+
+// Retained scene with cached world matrices. Nodes are stored parents-first, so
+// one forward pass propagates changes, and only dirty subtrees are recomputed.
+class SceneGraph
+{
+public:
+	// Number of world matrices recomputed by the last update()
+	unsigned int recomputed;
+
+	SceneGraph() : recomputed(0) {}
+
+	// Adds a node under parent (-1 for none) and returns its index
+	int addNode(int parent, const glm::vec3 &position, const glm::quat &rotation = glm::quat(), const glm::vec3 &scale = glm::vec3(1.0f))
+	{
+		SceneNode node;
+		node.parent = parent;
+		node.position = position;
+		node.rotation = rotation;
+		node.scale = scale;
+		node.mesh = Mesh();
+		node.texture = 0;
+		node.dirty = true;
+		node.moved = false;
+		node.uniform = true;
+
+		nodes.push_back(node);
+		world.push_back(glm::mat4());
+		normals.push_back(glm::mat3());
+
+		InstanceIndices none = { 0, 0 };
+		indices.push_back(none);
+
+		return (int)nodes.size() - 1;
+	}
+
+	// Adds a node that is drawn with the given mesh, diffuse texture array, material index and array layer
+	int addDrawable(int parent, const Mesh &mesh, unsigned int texture, int material, int layer, const glm::vec3 &position, const glm::quat &rotation = glm::quat(), const glm::vec3 &scale = glm::vec3(1.0f))
+	{
+		int index = addNode(parent, position, rotation, scale);
+		nodes[index].mesh = mesh;
+		nodes[index].texture = texture;
+		indices[index].material = material;
+		indices[index].layer = layer;
+
+		return index;
+	}
+
+	// Setters only mark the node dirty when the value actually changes
+	void setPosition(int index, const glm::vec3 &position)
+	{
+		if (nodes[index].position != position)
+		{
+			nodes[index].position = position;
+			nodes[index].dirty = true;
+		}
+	}
+
+	void setRotation(int index, const glm::quat &rotation)
+	{
+		if (nodes[index].rotation != rotation)
+		{
+			nodes[index].rotation = rotation;
+			nodes[index].dirty = true;
+		}
+	}
+
+	void setScale(int index, const glm::vec3 &scale)
+	{
+		if (nodes[index].scale != scale)
+		{
+			nodes[index].scale = scale;
+			nodes[index].dirty = true;
+		}
+	}
+
+	// Recomputes world and normal matrices of dirty nodes and everything below them
+	void update()
+	{
+		recomputed = 0;
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			SceneNode &node = nodes[i];
+
+			// the parent was visited earlier in this pass
+			if (node.parent >= 0 && nodes[node.parent].moved)
+				node.dirty = true;
+
+			node.moved = node.dirty;
+
+			if (!node.dirty)
+				continue;
+
+			glm::mat4 local = glm::translate(glm::mat4(), node.position) * glm::mat4_cast(node.rotation);
+			local = glm::scale(local, node.scale);
+
+			if (node.parent >= 0)
+				world[i] = world[node.parent] * local;
+			else
+				world[i] = local;
+
+			node.uniform = node.scale.x == node.scale.y && node.scale.y == node.scale.z && (node.parent < 0 || nodes[node.parent].uniform);
+			normals[i] = computeNormalMatrix(world[i], node.uniform);
+
+			node.dirty = false;
+			recomputed++;
+		}
+	}
+
+	// Groups consecutive drawable nodes that share a mesh and texture. The
+	// batches index straight into worldMatrices(), so they stay valid for as
+	// long as no nodes are added.
+	std::vector<InstanceBatch> buildBatches() const
+	{
+		std::vector<InstanceBatch> batches;
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const SceneNode &node = nodes[i];
+
+			if (node.mesh.indexCount == 0)
+				continue;
+
+			InstanceBatch *last = batches.empty() ? NULL : &batches.back();
+
+			if (last != NULL && last->mesh == node.mesh && last->texture == node.texture && last->first + last->count == i)
+			{
+				last->count++;
+			}
+			else
+			{
+				InstanceBatch batch = { node.mesh, node.texture, (unsigned int)i, 1 };
+				batches.push_back(batch);
+			}
+		}
+
+		return batches;
+	}
+
+	const SceneNode &node(int index) const
+	{
+		return nodes[index];
+	}
+
+	// Whether the node's world matrix was recomputed by the last update()
+	bool moved(int index) const
+	{
+		return nodes[index].moved;
+	}
+
+	const glm::mat4 &worldMatrix(int index) const
+	{
+		return world[index];
+	}
+
+	const glm::mat3 &normalMatrix(int index) const
+	{
+		return normals[index];
+	}
+
+	// Contiguous per-node arrays, ready to be copied into an instance buffer as-is
+	const glm::mat4 *worldMatrices() const
+	{
+		return &world[0];
+	}
+
+	const glm::mat3 *normalMatrices() const
+	{
+		return &normals[0];
+	}
+
+	const InstanceIndices *instanceIndices() const
+	{
+		return &indices[0];
+	}
+
+	unsigned int size() const
+	{
+		return (unsigned int)nodes.size();
+	}
+
+private:
+	std::vector<SceneNode> nodes;
+	std::vector<glm::mat4> world;
+	std::vector<glm::mat3> normals;
+	std::vector<InstanceIndices> indices;
+};
+
+#endif
@@ -3,30 +3,49 @@
 
 #include <glad/glad.h>
 
+#include "gl_state.h"
+#include "program_cache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <math.h>
 
+// Location of a uniform, resolved once when the program is linked
+struct UniformHandle
+{
+	GLint location;
+};
+
 class Shader
 {
 public:
 	// Program ID
 	unsigned int ID;
 
-	// Constructor for reading and building the shader
-	Shader(const char* vertexPath, const char* fragmentPath)
+	// Constructor for reading and building the shader; the geometry stage is optional.
+	// The program is only started here: it is loaded from the cache if there is one
+	// and it holds the program, or else its compiles are sent off without waiting.
+	// finish() (or the first use()) completes it, so a set of shaders constructed
+	// together compiles in parallel.
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = NULL, ProgramCache *cache = NULL)
+		: ID(0), cache(cache), cacheKey(0), pending(true), vertex(0), fragment(0), geometry(0)
 	{
 		// 1. retrieve the source code
 		std::string vertexCode;
 		std::string fragmentCode;
+		std::string geometryCode;
 		std::ifstream vShaderFile;
 		std::ifstream fShaderFile;
+		std::ifstream gShaderFile;
 
 		// Ensure ifstream objects can throw exceptions:
 		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
 		try
 		{
@@ -46,129 +65,298 @@ public:
 			// convert stream to string
 			vertexCode = vShaderStream.str();
 			fragmentCode = fShaderStream.str();
+
+			if (geometryPath != NULL)
+			{
+				gShaderFile.open(geometryPath);
+				std::stringstream gShaderStream;
+				gShaderStream << gShaderFile.rdbuf();
+				gShaderFile.close();
+				geometryCode = gShaderStream.str();
+			}
 		}
 		catch (std::ifstream::failure e)
 		{
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 		}
 
-		const char* vShaderCode = vertexCode.c_str();
-		const char* fShaderCode = fragmentCode.c_str();
+		vertexName = vertexPath;
+		fragmentName = fragmentPath;
+		geometryName = geometryPath != NULL ? geometryPath : "";
 
-		// 2. compile shaders
-		unsigned int vertex, fragment;
-		int success;
-		char infoLog[512];
-
-		// vertex shader
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
+		ID = glCreateProgram();
 
-		// print compile errors
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-		if (!success)
+		// 2. a binary saved by an earlier run skips compiling altogether
+		if (cache)
 		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << vertexPath << infoLog << std::endl;
-		}
-
-		// fragment shader
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
+			cacheKey = cache->key(vertexCode, fragmentCode, geometryCode);
+			if (cache->load(cacheKey, ID))
+				return;
 
-		// print compile errors
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << fragmentPath << infoLog << std::endl;
+			// a refused binary may have left the program in any state
+			glDeleteProgram(ID);
+			ID = glCreateProgram();
+			cache->prepare(ID);
 		}
 
-		// link shader program
-		ID = glCreateProgram();
+		// 3. compile and link; errors are only asked for in finish(), since asking waits for the result
+		vertex = compile(GL_VERTEX_SHADER, vertexCode);
+		fragment = compile(GL_FRAGMENT_SHADER, fragmentCode);
+		if (geometryPath != NULL)
+			geometry = compile(GL_GEOMETRY_SHADER, geometryCode);
+
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
+		if (geometry)
+			glAttachShader(ID, geometry);
 		glLinkProgram(ID);
+	}
 
-		// print program errors
-		glGetProgramiv(ID, GL_LINK_STATUS, &success);
-		if (!success)
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	// Waits for the program, prints any errors, saves it to the cache and looks up its
+	// uniforms; needed before uniform() and the setters, and done by use() if not yet
+	void finish()
+	{
+		if (!pending)
+			return;
+		pending = false;
+
+		// compiled from source rather than loaded
+		if (vertex)
 		{
-			glGetProgramInfoLog(ID, 512, NULL, infoLog);
-			std::cout << "ERROR::PROGRAM_LINKING_ERROR\n" << infoLog << std::endl;
+			int success;
+			char infoLog[512];
+
+			// print compile errors
+			checkCompile(vertex, "VERTEX", vertexName);
+			checkCompile(fragment, "FRAGMENT", fragmentName);
+			if (geometry)
+				checkCompile(geometry, "GEOMETRY", geometryName);
+
+			// print program errors
+			glGetProgramiv(ID, GL_LINK_STATUS, &success);
+			if (!success)
+			{
+				glGetProgramInfoLog(ID, 512, NULL, infoLog);
+				std::cout << "ERROR::PROGRAM_LINKING_ERROR\n" << infoLog << std::endl;
+			}
+			else if (cache)
+			{
+				cache->store(cacheKey, ID);
+			}
+
+			// delete shaders after they've been linked
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			if (geometry)
+				glDeleteShader(geometry);
+			vertex = fragment = geometry = 0;
 		}
 
-		// delete shaders after they've been linked
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
+		// cache uniform locations now rather than on every set* call
+		cacheUniformLocations();
 	}
 
 	// Method for using the shader
 	void use()
 	{
-		glUseProgram(ID);
+		if (pending)
+			finish();
+		glState().useProgram(ID);
+	}
+
+	// Returns a handle to a uniform, or a handle the setters ignore if it is not active
+	UniformHandle uniform(const std::string &name) const
+	{
+		std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(name);
+		UniformHandle handle = { it != uniformLocations.end() ? it->second : -1 };
+		return handle;
 	}
 	
 	// utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(uniform(name).location, (int)value); 
+    }
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
     }
 	// ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(uniform(name).location, value); 
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(handle.location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(uniform(name).location, value); 
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(handle.location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(uniform(name).location, 1, &value[0]); 
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        glUniform2fv(handle.location, 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(uniform(name).location, x, y); 
+    }
+    void setVec2(UniformHandle handle, float x, float y) const
+    {
+        glUniform2f(handle.location, x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(uniform(name).location, 1, &value[0]); 
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(handle.location, 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(uniform(name).location, x, y, z); 
+    }
+    void setVec3(UniformHandle handle, float x, float y, float z) const
+    {
+        glUniform3f(handle.location, x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(uniform(name).location, 1, &value[0]); 
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(handle.location, 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(uniform(name).location, x, y, z, w); 
+    }
+    void setVec4(UniformHandle handle, float x, float y, float z, float w)
+    {
+        glUniform4f(handle.location, x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniform(name).location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniform(name).location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniform(name).location, 1, GL_FALSE, &mat[0][0]);
     }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+private:
+	ProgramCache *cache;
+	unsigned long long cacheKey;
+	bool pending;	// started but not finish()ed yet
+
+	// Stages still compiling, and their paths for error messages
+	unsigned int vertex, fragment, geometry;
+	std::string vertexName, fragmentName, geometryName;
+
+	// Active uniform locations, filled in once after linking
+	std::unordered_map<std::string, GLint> uniformLocations;
+
+	static unsigned int compile(GLenum type, const std::string &code)
+	{
+		const char* source = code.c_str();
+		unsigned int shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	static void checkCompile(unsigned int shader, const char *stage, const std::string &path)
+	{
+		int success;
+		char infoLog[512];
+
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << path << infoLog << std::endl;
+		}
+	}
+
+	// Queries every active uniform so the setters never have to ask the driver
+	void cacheUniformLocations()
+	{
+		int count = 0;
+		int maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+		for (int i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type;
+			glGetActiveUniform(ID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, &nameBuffer[0]);
+
+			std::string name(&nameBuffer[0], length);
+			GLint location = glGetUniformLocation(ID, name.c_str());
+
+			// members of uniform blocks have no location of their own
+			if (location < 0)
+				continue;
+
+			uniformLocations[name] = location;
+
+			// arrays are reported as "name[0]", so register the bare name and every element too
+			size_t bracket = name.rfind("[0]");
+			if (bracket != std::string::npos && bracket + 3 == name.size())
+			{
+				std::string base = name.substr(0, bracket);
+				uniformLocations[base] = location;
+
+				for (int j = 1; j < size; j++)
+				{
+					std::string element = base + "[" + std::to_string(j) + "]";
+					uniformLocations[element] = glGetUniformLocation(ID, element.c_str());
+				}
+			}
+		}
+	}
 };
 
 #endif
@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec3 FragPos;
+
+uniform vec3 shadowLightPos;
+uniform float shadowFar;
+
+// depth is the distance to the light, so lookups need no projection
+void main()
+{
+	gl_FragDepth = length(FragPos - shadowLightPos) / shadowFar;
+}
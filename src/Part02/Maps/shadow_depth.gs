@@ -0,0 +1,24 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+// view-projection of each cube face, see PointShadow::faceMatrices()
+uniform mat4 shadowMatrices[6];
+
+out vec3 FragPos;
+
+// Sends every triangle to all six faces of the cube in one pass
+void main()
+{
+	for (int face = 0; face < 6; face++)
+	{
+		gl_Layer = face;
+		for (int i = 0; i < 3; i++)
+		{
+			FragPos = gl_in[i].gl_Position.xyz;
+			gl_Position = shadowMatrices[face] * gl_in[i].gl_Position;
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+}
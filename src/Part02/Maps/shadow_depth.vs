@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// per-instance model matrix, as in maplighting.vs
+layout (location = 3) in mat4 aModel;
+
+// world space; the geometry shader projects it onto each cube face
+void main()
+{
+	gl_Position = aModel * vec4(aPos, 1.0);
+}
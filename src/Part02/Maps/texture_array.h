@@ -0,0 +1,157 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "gl_state.h"
+#include "texture_loader.h"
+
+// Packs 2D textures into the layers of one GL_TEXTURE_2D_ARRAY, so a whole
+// pass can sample every material through a single binding and pick its image
+// by layer index. Every layer has the same size and RGBA8 format, which the
+// owner takes from the largest texture going in (see TextureLoader::imageSize()):
+// a texture of that size keeps its mip chain exactly, baked or generated,
+// while smaller or differently shaped ones are scaled to fit with a
+// framebuffer blit per level. That costs memory and distorts textures of
+// another aspect ratio, in exchange for one binding per pass; textures that
+// differ a lot belong in arrays of their own.
+//
+// Each texture is loaded through a TextureLoader, copied into its layer once
+// its image is final, and then deleted, so only the array stays on the GPU.
+class TextureArray
+{
+public:
+	// Array texture ID
+	unsigned int ID;
+
+	// Read and draw framebuffers used for the layer copies
+	unsigned int FBO[2];
+
+	TextureArray(unsigned int width, unsigned int height, unsigned int maxLayers) : width(width), height(height), maxLayers(maxLayers), levels(1), layers(0)
+	{
+		while ((width >> levels) > 0 || (height >> levels) > 0)
+			levels++;
+
+		glGenTextures(1, &ID);
+		glState().bindTexture(GL_TEXTURE_2D_ARRAY, ID);
+
+		for (unsigned int i = 0; i < levels; i++)
+		{
+			unsigned int w = width >> i, h = height >> i;
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, w > 0 ? w : 1, h > 0 ? h : 1, maxLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		glGenFramebuffers(2, FBO);
+	}
+
+	TextureArray(const TextureArray&) = delete;
+	TextureArray& operator=(const TextureArray&) = delete;
+
+	// Loads a texture into the next free layer and returns the layer, or -1 when
+	// full. Until the loader has its image, the layer shows the placeholder.
+	int load(TextureLoader &loader, const std::string &path)
+	{
+		if (layers >= maxLayers)
+		{
+			std::cout << "ERROR::TEXTURE_ARRAY::FULL" << std::endl;
+			return -1;
+		}
+
+		unsigned int layer = layers++;
+		unsigned int texture = loader.load(path);
+		copy(texture, layer);
+
+		// baked textures are final straight away
+		if (loader.loading(texture))
+			pending[texture] = layer;
+		else
+			glState().deleteTexture(texture);
+
+		return (int)layer;
+	}
+
+	// Copies the images TextureLoader::update() just uploaded into their
+	// layers and deletes the textures they came in
+	void refresh(const std::vector<unsigned int> &uploaded)
+	{
+		for (size_t i = 0; i < uploaded.size(); i++)
+		{
+			std::map<unsigned int, unsigned int>::iterator it = pending.find(uploaded[i]);
+			if (it == pending.end())
+				continue;
+
+			copy(it->first, it->second);
+			glState().deleteTexture(it->first);
+			pending.erase(it);
+		}
+	}
+
+	unsigned int size() const
+	{
+		return layers;
+	}
+
+private:
+	unsigned int width, height, maxLayers, levels, layers;
+	std::map<unsigned int, unsigned int> pending;	// layer of each texture still waiting for its image
+
+	// Copies every level of a layer from a texture, each from the smallest
+	// of the texture's levels that still covers it
+	void copy(unsigned int texture, unsigned int layer)
+	{
+		std::vector<GLint> sourceWidths, sourceHeights;
+		glState().bindTexture(GL_TEXTURE_2D, texture);
+
+		for (GLint level = 0; ; level++)
+		{
+			GLint w = 0, h = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &w);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &h);
+			if (w == 0 || h == 0)
+				break;
+
+			sourceWidths.push_back(w);
+			sourceHeights.push_back(h);
+		}
+
+		if (sourceWidths.empty())
+			return;
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO[0]);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO[1]);
+
+		size_t source = 0;
+		for (unsigned int i = 0; i < levels; i++)
+		{
+			GLint w = width >> i, h = height >> i;
+			w = w > 0 ? w : 1;
+			h = h > 0 ? h : 1;
+
+			while (source + 1 < sourceWidths.size() && sourceWidths[source + 1] >= w && sourceHeights[source + 1] >= h)
+				source++;
+
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, (GLint)source);
+			glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, ID, i, layer);
+
+			// a level of the same size is copied as it is
+			bool sameSize = sourceWidths[source] == w && sourceHeights[source] == h;
+			glBlitFramebuffer(0, 0, sourceWidths[source], sourceHeights[source], 0, 0, w, h, GL_COLOR_BUFFER_BIT, sameSize ? GL_NEAREST : GL_LINEAR);
+		}
+
+		// an attachment would keep the texture alive after it is deleted
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+#include "gl_state.h"
+#include "texture_pack.h"
+
+// Loads textures without stalling the GL thread. load() hands out a texture
+// name straight away, filled with a 1x1 placeholder; worker threads decode
+// the image with stb_image, and update() (called once per frame on the GL
+// thread) copies finished images into the textures through pixel unpack
+// buffers. Textures found in a baked pack (see usePack()) skip all of that
+// and are uploaded straight from the mapped file.
+class TextureLoader
+{
+public:
+	// Pixel unpack buffer IDs, used in turn so consecutive uploads don't wait on each other
+	unsigned int PBO[2];
+
+	TextureLoader(bool flipVertically = false, unsigned int threadCount = 0) : flipVertically(flipVertically), pack(NULL), nextPBO(0), queued(0), stopping(false)
+	{
+		// stb_image keeps this flag in a global, so set it before any worker can read it
+		stbi_set_flip_vertically_on_load(flipVertically);
+
+		glGenBuffers(2, PBO);
+
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+
+		for (unsigned int i = 0; i < threadCount; i++)
+			workers.push_back(std::thread(&TextureLoader::work, this));
+	}
+
+	// Stops the workers; the GL objects are deleted by the owner while the context is still alive
+	~TextureLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+
+		for (size_t i = 0; i < decoded.size(); i++)
+			stbi_image_free(decoded[i].data);
+	}
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	// Looks textures up in a baked pack first; the pack must outlive the loader
+	void usePack(const TexturePack *texturePack)
+	{
+		if (texturePack != NULL && texturePack->isOpen() && texturePack->flipped() != flipVertically)
+		{
+			std::cout << "WARNING::TEXTURE::PACK_ORIENTATION_MISMATCH, decoding images instead" << std::endl;
+			texturePack = NULL;
+		}
+
+		pack = texturePack;
+	}
+
+	// Returns a texture that shows the placeholder colour until its image has been uploaded
+	unsigned int load(const std::string &path, const unsigned char placeholder[4] = NULL)
+	{
+		static const unsigned char grey[4] = { 128, 128, 128, 255 };
+
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+		glState().bindTexture(GL_TEXTURE_2D, textureID);
+
+		const TexturePackEntry *baked = pack != NULL ? pack->find(path) : NULL;
+		if (baked != NULL)
+		{
+			uploadBaked(*baked);
+			return textureID;
+		}
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder != NULL ? placeholder : grey);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		loadingTextures.insert(textureID);
+
+		Job job = { textureID, path };
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(job);
+			queued++;
+		}
+		wake.notify_one();
+
+		return textureID;
+	}
+
+	// Uploads up to maxUploads decoded images; returns how many are still outstanding
+	unsigned int update(unsigned int maxUploads = 2)
+	{
+		uploadedTextures.clear();
+
+		for (unsigned int i = 0; i < maxUploads; i++)
+		{
+			Image image;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (decoded.empty())
+					break;
+
+				image = decoded.front();
+				decoded.pop_front();
+			}
+
+			upload(image);
+			stbi_image_free(image.data);
+			uploadedTextures.push_back(image.texture);
+			loadingTextures.erase(image.texture);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			queued--;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		return queued;
+	}
+
+	// Textures whose images arrived in the last update()
+	const std::vector<unsigned int> &uploaded() const
+	{
+		return uploadedTextures;
+	}
+
+	// Whether a texture from load() still shows its placeholder and will be in a later uploaded()
+	bool loading(unsigned int texture) const
+	{
+		return loadingTextures.count(texture) != 0;
+	}
+
+	// Size of the image at path, read from the pack or the file's header without decoding it
+	bool imageSize(const std::string &path, int &width, int &height) const
+	{
+		const TexturePackEntry *baked = pack != NULL ? pack->find(path) : NULL;
+		if (baked != NULL)
+		{
+			width = (int)baked->width;
+			height = (int)baked->height;
+			return true;
+		}
+
+		int components;
+		return stbi_info(path.c_str(), &width, &height, &components) != 0;
+	}
+
+	// Blocks until every queued texture has been uploaded
+	void finish()
+	{
+		while (update(~0u) > 0)
+			std::this_thread::yield();
+	}
+
+private:
+	struct Job
+	{
+		unsigned int texture;
+		std::string path;
+	};
+
+	struct Image
+	{
+		unsigned int texture;
+		std::string path;
+		unsigned char *data;	// NULL when decoding failed
+		int width, height, components;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<Job> jobs;
+	std::deque<Image> decoded;
+	std::vector<unsigned int> uploadedTextures;
+	std::set<unsigned int> loadingTextures;	// loaded but not yet uploaded, only touched on the GL thread
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	bool flipVertically;
+	const TexturePack *pack;
+
+	unsigned int nextPBO;
+	unsigned int queued;	// loaded but not yet uploaded
+	bool stopping;
+
+	// Worker thread: decodes queued files until the loader is destroyed
+	void work()
+	{
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+				if (stopping)
+					return;
+
+				job = jobs.front();
+				jobs.pop_front();
+			}
+
+			Image image;
+			image.texture = job.texture;
+			image.path = job.path;
+			image.data = stbi_load(job.path.c_str(), &image.width, &image.height, &image.components, 0);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.push_back(image);
+		}
+	}
+
+	// Uploads every mip level of a baked texture into the bound texture
+	void uploadBaked(const TexturePackEntry &entry)
+	{
+		GLenum format = GL_RGB;
+		if (entry.components == 1)
+			format = GL_RED;
+		else if (entry.components == 4)
+			format = GL_RGBA;
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		for (uint32_t i = 0; i < entry.levels; i++)
+		{
+			GLsizei width = entry.width >> i, height = entry.height >> i;
+			glTexImage2D(GL_TEXTURE_2D, i, format, width > 0 ? width : 1, height > 0 ? height : 1, 0, format, GL_UNSIGNED_BYTE, pack->level(entry, i));
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+
+	// Copies one decoded image into its texture through the next PBO
+	void upload(const Image &image)
+	{
+		if (image.data == NULL)
+		{
+			std::cout << "Texture failed to load at path: " << image.path << std::endl;
+			return;
+		}
+
+		GLenum format = GL_RGB;
+		if (image.components == 1)
+			format = GL_RED;
+		else if (image.components == 4)
+			format = GL_RGBA;
+
+		size_t size = (size_t)image.width * image.height * image.components;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO[nextPBO]);
+		nextPBO = (nextPBO + 1) % 2;
+
+		// orphan the previous contents so the copy never waits on an upload still in flight
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		void *pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (pixels == NULL)
+			return;
+
+		memcpy(pixels, image.data, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// rows of 1 and 3 component images aren't necessarily 4-byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		glState().bindTexture(GL_TEXTURE_2D, image.texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (void*)0);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef TEXTURE_PACK_H
+#define TEXTURE_PACK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <iostream>
+
+#include "mapped_file.h"
+
+// Container of pre-baked textures written by TextureBake. Layout:
+//
+//	TexturePackHeader
+//	TexturePackEntry[textureCount]
+//	mip chains, each level tightly packed (no row padding) and each chain 16-byte aligned
+//
+// Pixels are stored uncompressed as 8-bit R, RGB or RGBA, exactly as they are
+// handed to glTexImage2D, so loading is a straight copy out of the mapping.
+
+const uint32_t TEXTURE_PACK_VERSION = 1;
+const int TEXTURE_PACK_NAME_LENGTH = 64;
+const uint32_t TEXTURE_PACK_MAX_LEVELS = 32;	// a full chain for 32-bit dimensions
+
+// Header flags
+const uint32_t TEXTURE_PACK_FLIPPED = 1;	// rows stored bottom-up, like stbi_set_flip_vertically_on_load(true)
+
+struct TexturePackHeader
+{
+	char magic[4];		// "GHTP"
+	uint32_t version;
+	uint32_t flags;
+	uint32_t textureCount;
+};
+
+struct TexturePackEntry
+{
+	char name[TEXTURE_PACK_NAME_LENGTH];	// file name without its directory, e.g. "wood2.jpg"
+	uint32_t width;
+	uint32_t height;
+	uint32_t components;
+	uint32_t levels;
+	uint64_t offset;	// of level 0 from the start of the pack
+	uint64_t size;		// of the whole mip chain
+};
+
+// Byte size of one mip level
+inline size_t textureLevelSize(uint32_t width, uint32_t height, uint32_t components, uint32_t level)
+{
+	size_t w = width >> level, h = height >> level;
+	return (w > 0 ? w : 1) * (h > 0 ? h : 1) * components;
+}
+
+// Read-only view of a pack file, mapped into memory
+class TexturePack
+{
+public:
+	// Maps a pack and checks every entry against the file, so find() and
+	// level() never read past the mapping of a truncated or hand-made pack
+	bool open(const std::string &path)
+	{
+		if (!file.open(path) || file.size() < sizeof(TexturePackHeader))
+			return false;
+
+		const TexturePackHeader &h = header();
+		uint64_t end = sizeof(TexturePackHeader) + (uint64_t)h.textureCount * sizeof(TexturePackEntry);
+
+		if (memcmp(h.magic, "GHTP", 4) != 0 || h.version != TEXTURE_PACK_VERSION || end > file.size())
+		{
+			file.close();
+			return false;
+		}
+
+		for (uint32_t i = 0; i < h.textureCount; i++)
+		{
+			if (!validEntry(entries()[i]))
+			{
+				std::cout << "WARNING::TEXTURE_PACK::INVALID_ENTRY, decoding instead\n" << path << std::endl;
+				file.close();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool isOpen() const { return file.isOpen(); }
+
+	bool flipped() const
+	{
+		return (header().flags & TEXTURE_PACK_FLIPPED) != 0;
+	}
+
+	// Finds a texture by the file name part of path, or returns NULL
+	const TexturePackEntry *find(const std::string &path) const
+	{
+		if (!isOpen())
+			return NULL;
+
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+		for (uint32_t i = 0; i < header().textureCount; i++)
+		{
+			if (name == entries()[i].name)
+				return &entries()[i];
+		}
+
+		return NULL;
+	}
+
+	// Pixels of one mip level of a texture
+	const unsigned char *level(const TexturePackEntry &entry, uint32_t level) const
+	{
+		size_t offset = entry.offset;
+		for (uint32_t i = 0; i < level; i++)
+			offset += textureLevelSize(entry.width, entry.height, entry.components, i);
+
+		return (const unsigned char*)file.data() + offset;
+	}
+
+private:
+	MappedFile file;
+
+	const TexturePackHeader &header() const
+	{
+		return *(const TexturePackHeader*)file.data();
+	}
+
+	const TexturePackEntry *entries() const
+	{
+		return (const TexturePackEntry*)(file.data() + sizeof(TexturePackHeader));
+	}
+
+	// Whether an entry's name is terminated and its mip chain is consistent and inside the file
+	bool validEntry(const TexturePackEntry &entry) const
+	{
+		if (memchr(entry.name, '\0', TEXTURE_PACK_NAME_LENGTH) == NULL)
+			return false;
+		if (entry.width == 0 || entry.height == 0 || entry.components == 0 || entry.components > 4)
+			return false;
+		if (entry.levels == 0 || entry.levels > TEXTURE_PACK_MAX_LEVELS)
+			return false;
+		// level 0 alone must fit, which also keeps the sum below from overflowing
+		if ((uint64_t)entry.width * entry.height > file.size() / entry.components)
+			return false;
+
+		uint64_t size = 0;
+		for (uint32_t i = 0; i < entry.levels; i++)
+			size += textureLevelSize(entry.width, entry.height, entry.components, i);
+
+		return size == entry.size && entry.offset <= file.size() && entry.size <= file.size() - entry.offset;
+	}
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string.h>
+
+#include "dynamic_buffer.h"
+
+// Binding point every program's FrameData block is attached to
+const unsigned int FRAME_DATA_BINDING = 0;
+
+// CPU mirror of the std140 FrameData block declared in the shaders:
+//
+//	layout (std140) uniform FrameData
+//	{
+//		mat4 projection;
+//		mat4 view;
+//		vec3 viewPos;
+//		Light light;	// position, ambient, diffuse, specular, falloff
+//	};
+//
+// vec3 members are padded to 16 bytes, except where a float can take the
+// last slot (light.specular + light.falloff).
+struct FrameData
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+
+	glm::vec4 lightPosition;
+	glm::vec4 lightAmbient;
+	glm::vec4 lightDiffuse;
+	glm::vec3 lightSpecular;
+	float lightFalloff;
+};
+
+static_assert(sizeof(FrameData) == 208, "FrameData must match the std140 layout of the FrameData block");
+
+// Per-frame camera and light state, written once per frame and shared by every program
+class FrameUniforms
+{
+public:
+	// Buffer ID
+	unsigned int UBO;
+
+	// Values uploaded by the next call to upload()
+	FrameData data;
+
+	FrameUniforms() : data(), offsetAlignment(256)
+	{
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+
+		glGenBuffers(1, &UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, UBO);
+	}
+
+	// The buffer is owned by exactly one object
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	// Points a program's FrameData block at the shared binding; programs without the block are ignored
+	void attach(unsigned int program) const
+	{
+		unsigned int index = glGetUniformBlockIndex(program, "FrameData");
+
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, FRAME_DATA_BINDING);
+	}
+
+	void setCamera(const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &viewPos)
+	{
+		data.projection = projection;
+		data.view = view;
+		data.viewPos = glm::vec4(viewPos, 1.0f);
+	}
+
+	void setLight(const glm::vec3 &position, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular, float falloff)
+	{
+		data.lightPosition = glm::vec4(position, 1.0f);
+		data.lightAmbient = glm::vec4(ambient, 0.0f);
+		data.lightDiffuse = glm::vec4(diffuse, 0.0f);
+		data.lightSpecular = specular;
+		data.lightFalloff = falloff;
+	}
+
+	// Sends the whole block to the GPU in a single call
+	void upload() const
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, UBO);
+	}
+
+	// Copies the block into this frame's part of a ring buffer and binds that
+	// range instead, so the upload never waits on draws still reading the last one
+	void upload(DynamicBuffer &buffer) const
+	{
+		size_t offset;
+		void *target = buffer.allocate(sizeof(FrameData), offsetAlignment, offset);
+
+		if (!target)
+		{
+			upload();
+			return;
+		}
+
+		memcpy(target, &data, sizeof(FrameData));
+		buffer.commit();
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, buffer.ID, offset, sizeof(FrameData));
+	}
+
+private:
+	GLint offsetAlignment;	// uniform blocks must start at a multiple of this
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <cstddef>
+
+// Vertex layout meshes are authored in: position, normal and texture coordinates as 8 floats (32 bytes)
+struct MeshVertex
+{
+	float position[3];
+	float normal[3];
+	float texCoords[2];
+};
+
+// The same vertex in 20 bytes: the normal packed into 10 bits per axis
+// (GL_INT_2_10_10_10_REV) and the texture coordinates as half floats
+struct PackedVertex
+{
+	float position[3];
+	uint32_t normal;
+	uint16_t texCoords[2];
+};
+
+// How a mesh pool stores its vertices on the GPU. Either way the shaders see
+// the usual vec3 aPos, vec3 aNormal and vec2 aTexCoords at locations 0-2.
+enum VertexFormat
+{
+	VERTEX_FORMAT_FLOAT,	// MeshVertex
+	VERTEX_FORMAT_PACKED	// PackedVertex
+};
+
+inline unsigned int vertexStride(VertexFormat format)
+{
+	return format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(MeshVertex);
+}
+
+// Converts a float to IEEE half precision, rounding to nearest
+inline uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	// infinity and NaN
+	if (((bits >> 23) & 0xff) == 0xff)
+		return (uint16_t)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+	// too large for a half
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7c00);
+
+	// too small even for a denormal half
+	if (exponent < -10)
+		return (uint16_t)sign;
+
+	// denormal half: shift the implicit leading one into the mantissa
+	if (exponent <= 0)
+	{
+		mantissa |= 0x800000;
+		uint32_t shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+		return (uint16_t)(sign | half);
+	}
+
+	// a rounding carry out of the mantissa correctly bumps the exponent
+	uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+	return (uint16_t)half;
+}
+
+// Packs a unit vector into GL_INT_2_10_10_10_REV as signed normalized x, y, z (w is 0)
+inline uint32_t packNormal(const float normal[3])
+{
+	uint32_t packed = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		float n = normal[i] < -1.0f ? -1.0f : (normal[i] > 1.0f ? 1.0f : normal[i]);
+		int value = (int)(n * 511.0f + (n < 0.0f ? -0.5f : 0.5f));
+		packed |= ((uint32_t)value & 0x3ff) << (10 * i);
+	}
+
+	return packed;
+}
+
+inline PackedVertex packVertex(const MeshVertex &vertex)
+{
+	PackedVertex packed;
+	memcpy(packed.position, vertex.position, sizeof(packed.position));
+	packed.normal = packNormal(vertex.normal);
+	packed.texCoords[0] = floatToHalf(vertex.texCoords[0]);
+	packed.texCoords[1] = floatToHalf(vertex.texCoords[1]);
+	return packed;
+}
+
+// Converts count vertices from the float layout
+inline void packVertices(const MeshVertex *vertices, unsigned int count, PackedVertex *packed)
+{
+	for (unsigned int i = 0; i < count; i++)
+		packed[i] = packVertex(vertices[i]);
+}
+
+// Points attributes 0-2 of the bound VAO at the bound vertex buffer
+inline void setVertexAttributes(VertexFormat format)
+{
+	GLsizei stride = vertexStride(format);
+
+	// position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glEnableVertexAttribArray(0);
+
+	if (format == VERTEX_FORMAT_PACKED)
+	{
+		// normal attribute, normalized to [-1, 1]; the shader ignores the w bits
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+		glEnableVertexAttribArray(1);
+
+		// texture attribute
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, texCoords));
+		glEnableVertexAttribArray(2);
+	}
+	else
+	{
+		// normal attribute
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(MeshVertex, normal));
+		glEnableVertexAttribArray(1);
+
+		// texture attribute
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(MeshVertex, texCoords));
+		glEnableVertexAttribArray(2);
+	}
+}
+
+#endif
@@ -0,0 +1,182 @@
+// Bakes images into a texture pack (see Maps/texture_pack.h) with full mip
+// chains, so programs can upload them without decoding or glGenerateMipmap.
+//
+// Usage, from the repository root:
+//
+//	TextureBake [--flip] <output.pack> <image>...
+//	TextureBake resources/textures.pack resources/textures/*
+//	TextureBake --flip resources/textures_flipped.pack resources/textures/*
+//
+// --flip stores rows bottom-up, for programs that load with
+// stbi_set_flip_vertically_on_load(true) (sample2 does).
+//
+// Build it like the other programs, linking stb_image.cpp, e.g.
+//
+//	g++ -std=c++11 -O2 -I<includes> src/Part02/TextureBake/TextureBake.cpp src/stb_image.cpp -o TextureBake
+
+#include <stb_image.h>
+
+#include "../Maps/texture_pack.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+struct BakedTexture
+{
+	TexturePackEntry entry;
+	std::vector<unsigned char> pixels;	// every mip level, back to back
+};
+
+// Averages 2x2 blocks of the previous level; odd edges reuse their last row or column
+void downsample(const unsigned char *src, uint32_t width, uint32_t height, uint32_t components, unsigned char *dest)
+{
+	uint32_t destWidth = width > 1 ? width / 2 : 1;
+	uint32_t destHeight = height > 1 ? height / 2 : 1;
+
+	for (uint32_t y = 0; y < destHeight; y++)
+	{
+		uint32_t y0 = y * 2, y1 = y0 + 1 < height ? y0 + 1 : y0;
+
+		for (uint32_t x = 0; x < destWidth; x++)
+		{
+			uint32_t x0 = x * 2, x1 = x0 + 1 < width ? x0 + 1 : x0;
+
+			for (uint32_t c = 0; c < components; c++)
+			{
+				unsigned int sum = src[(y0 * width + x0) * components + c]
+					+ src[(y0 * width + x1) * components + c]
+					+ src[(y1 * width + x0) * components + c]
+					+ src[(y1 * width + x1) * components + c];
+
+				dest[(y * destWidth + x) * components + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+bool bake(const std::string &path, BakedTexture &texture)
+{
+	int width, height, components;
+	unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 0);
+
+	if (data == NULL)
+	{
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return false;
+	}
+
+	size_t slash = path.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+	if (name.size() >= (size_t)TEXTURE_PACK_NAME_LENGTH)
+	{
+		std::cout << "Texture name too long: " << name << std::endl;
+		stbi_image_free(data);
+		return false;
+	}
+
+	TexturePackEntry &entry = texture.entry;
+	memset(&entry, 0, sizeof(entry));
+	strcpy(entry.name, name.c_str());
+	entry.width = width;
+	entry.height = height;
+	entry.components = components;
+
+	// levels down to 1x1, as glGenerateMipmap would make
+	entry.levels = 1;
+	while ((entry.width >> entry.levels) > 0 || (entry.height >> entry.levels) > 0)
+		entry.levels++;
+
+	size_t total = 0;
+	for (uint32_t i = 0; i < entry.levels; i++)
+		total += textureLevelSize(entry.width, entry.height, entry.components, i);
+
+	texture.pixels.resize(total);
+	entry.size = total;
+
+	memcpy(&texture.pixels[0], data, textureLevelSize(entry.width, entry.height, entry.components, 0));
+	stbi_image_free(data);
+
+	size_t offset = 0;
+	for (uint32_t i = 1; i < entry.levels; i++)
+	{
+		size_t previous = textureLevelSize(entry.width, entry.height, entry.components, i - 1);
+		uint32_t w = entry.width >> (i - 1), h = entry.height >> (i - 1);
+
+		downsample(&texture.pixels[offset], w > 0 ? w : 1, h > 0 ? h : 1, entry.components, &texture.pixels[offset + previous]);
+		offset += previous;
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	int arg = 1;
+	bool flip = false;
+
+	if (arg < argc && strcmp(argv[arg], "--flip") == 0)
+	{
+		flip = true;
+		arg++;
+	}
+
+	if (argc - arg < 2)
+	{
+		std::cout << "Usage: TextureBake [--flip] <output.pack> <image>..." << std::endl;
+		return 1;
+	}
+
+	std::string outputPath = argv[arg++];
+	stbi_set_flip_vertically_on_load(flip);
+
+	std::vector<BakedTexture> textures;
+	for (; arg < argc; arg++)
+	{
+		BakedTexture texture;
+		if (bake(argv[arg], texture))
+			textures.push_back(texture);
+	}
+
+	TexturePackHeader header;
+	memcpy(header.magic, "GHTP", 4);
+	header.version = TEXTURE_PACK_VERSION;
+	header.flags = flip ? TEXTURE_PACK_FLIPPED : 0;
+	header.textureCount = (uint32_t)textures.size();
+
+	// place the mip chains after the entry table, each one 16-byte aligned
+	uint64_t offset = sizeof(TexturePackHeader) + textures.size() * sizeof(TexturePackEntry);
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		offset = (offset + 15) & ~(uint64_t)15;
+		textures[i].entry.offset = offset;
+		offset += textures[i].entry.size;
+	}
+
+	std::ofstream output(outputPath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!output)
+	{
+		std::cout << "Failed to open " << outputPath << " for writing" << std::endl;
+		return 1;
+	}
+
+	output.write((const char*)&header, sizeof(header));
+	for (size_t i = 0; i < textures.size(); i++)
+		output.write((const char*)&textures[i].entry, sizeof(TexturePackEntry));
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		static const char padding[16] = {};
+		size_t position = (size_t)output.tellp();
+		output.write(padding, textures[i].entry.offset - position);
+		output.write((const char*)&textures[i].pixels[0], textures[i].pixels.size());
+	}
+
+	std::cout << "Baked " << textures.size() << " textures into " << outputPath << " (" << offset << " bytes)" << std::endl;
+	return 0;
+}